@@ -222,6 +222,9 @@ int main(int argc, char** argv)
         // initialized by rocky (tile merges for example)
         viewer->update();
 
+        // compile what the update pass queued, and integrate compile results
+        ri.runtime().update();
+
         viewer->recordAndSubmit();
         viewer->present();
 
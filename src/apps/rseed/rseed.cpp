@@ -0,0 +1,280 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+
+/**
+* RSEED pre-generates the tiles of a map over an area so that an application
+* can later run from the cache without a network connection.
+*
+* Tiles go into the disk cache given with --cache (or ROCKY_CACHE_PATH), and
+* one layer at a time can also be exported to an MBTiles database. If a run
+* is interrupted, run it again with the same arguments to resume.
+*/
+
+#include <rocky/Instance.h>
+#include <rocky/Version.h>
+#include <rocky/Map.h>
+#include <rocky/TileSeeder.h>
+#include <rocky/TileLayer.h>
+#include <rocky/ElevationLayer.h>
+#include <rocky/DiskCache.h>
+#include <rocky/Image.h>
+#include <rocky/Utils.h>
+#include <rocky/Feature.h>
+
+#ifdef ROCKY_HAS_MBTILES
+#include <rocky/MBTiles.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace ROCKY_NAMESPACE;
+
+int usage(const char* name)
+{
+    std::cout
+        << "Usage: " << name << " --map <file.json> [options]\n"
+        << "  --extent <west,south,east,north>  Area to seed, in degrees (default: whole map)\n"
+#ifdef ROCKY_HAS_GDAL
+        << "  --area <file>                     Only seed inside the polygons in this vector file\n"
+#endif
+        << "  --min <level>                     First level to seed (default: 0)\n"
+        << "  --max <level>                     Last level to seed (required)\n"
+        << "  --layer <name>                    Only seed this layer (default: all image and elevation layers)\n"
+        << "  --cache <folder>                  Disk cache to populate (default: $ROCKY_CACHE_PATH)\n"
+#ifdef ROCKY_HAS_MBTILES
+        << "  --mbtiles <file.mbtiles>          Also export the tiles of the (single) seeded layer\n"
+#endif
+        << "  --threads <count>                 Tiles to create in parallel (default: 8)\n"
+        << "  --checkpoint <file>               Progress file for resuming (default: <cache>/seed.checkpoint)\n"
+        << "  --count                           Print the number of tile keys and quit\n"
+        << std::endl;
+    return -1;
+}
+
+int error(const std::string& msg)
+{
+    Log()->warn(msg);
+    return -1;
+}
+
+// Looks for "--name value" on the command line.
+bool read(int argc, char** argv, const char* name, std::string& value)
+{
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        if (::strcmp(argv[i], name) == 0)
+        {
+            value = argv[i + 1];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool read(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i < argc; ++i)
+        if (::strcmp(argv[i], name) == 0)
+            return true;
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || read(argc, argv, "--help"))
+        return usage(argv[0]);
+
+    Instance instance;
+    auto& io = instance.ioOptions();
+
+    std::string arg;
+
+    // the map to seed:
+    auto map = Map::create(instance);
+    if (!read(argc, argv, "--map", arg))
+        return usage(argv[0]);
+
+    std::string map_json;
+    if (!util::readFromFile(map_json, arg))
+        return error("Failed to read map from \"" + arg + "\"");
+
+    map->from_json(map_json);
+    if (map->layers().empty())
+        return error("No layers found in map file \"" + arg + "\"");
+
+    TileSeeder seeder;
+
+    if (read(argc, argv, "--extent", arg))
+    {
+        double w, s, e, n;
+        if (::sscanf(arg.c_str(), "%lf,%lf,%lf,%lf", &w, &s, &e, &n) != 4)
+            return usage(argv[0]);
+        seeder.extent = GeoExtent(SRS::WGS84, w, s, e, n);
+    }
+
+#ifdef ROCKY_HAS_GDAL
+    if (read(argc, argv, "--area", arg))
+    {
+        auto fs = OGRFeatureSource::create();
+        fs->uri = arg;
+        auto status = fs->open();
+        if (status.failed())
+            return error("Failed to open \"" + arg + "\" : " + status.message);
+
+        // gather all the polygons into one multipolygon:
+        auto area = std::make_shared<Feature>();
+        area->geometry.type = Geometry::Type::MultiPolygon;
+
+        auto iter = fs->iterate(io);
+        while (iter->hasMore())
+        {
+            auto& feature = iter->next();
+            if (!feature.valid())
+                continue;
+
+            area->srs = feature.srs;
+
+            if (feature.geometry.type == Geometry::Type::Polygon)
+                area->geometry.parts.push_back(feature.geometry);
+            else if (feature.geometry.type == Geometry::Type::MultiPolygon)
+                area->geometry.parts.insert(area->geometry.parts.end(), feature.geometry.parts.begin(), feature.geometry.parts.end());
+        }
+
+        if (area->geometry.parts.empty())
+            return error("No polygons found in \"" + arg + "\"");
+
+        area->dirtyExtent();
+        seeder.area = area;
+    }
+#endif
+
+    if (read(argc, argv, "--min", arg))
+        seeder.minLevel = std::stoul(arg);
+
+    if (!read(argc, argv, "--max", arg))
+        return usage(argv[0]);
+    seeder.maxLevel = std::stoul(arg);
+
+    if (read(argc, argv, "--threads", arg))
+        seeder.concurrency = std::stoul(arg);
+
+    if (read(argc, argv, "--layer", arg))
+    {
+        auto layer = map->layers().withName<TileLayer>(arg);
+        if (!layer)
+            return error("No tile layer named \"" + arg + "\" in the map");
+        seeder.layers.push_back(layer);
+    }
+
+    if (read(argc, argv, "--count"))
+    {
+        std::cout << seeder.count(map.get()) << std::endl;
+        return 0;
+    }
+
+    // the cache to populate:
+    std::string cache_path;
+    if (read(argc, argv, "--cache", cache_path))
+    {
+        auto cache = DiskCache::create(cache_path);
+        io.services.cache = [cache]() { return cache; };
+    }
+    else if (io.services.cache && io.services.cache())
+    {
+        auto disk_cache = std::dynamic_pointer_cast<DiskCache>(io.services.cache());
+        if (disk_cache)
+            cache_path = disk_cache->rootPath();
+    }
+
+    if (read(argc, argv, "--checkpoint", arg))
+        seeder.checkpoint = arg;
+    else if (!cache_path.empty())
+        seeder.checkpoint = cache_path + "/seed.checkpoint";
+
+#ifdef ROCKY_HAS_MBTILES
+    MBTiles::Driver mbtiles;
+    if (read(argc, argv, "--mbtiles", arg))
+    {
+        auto layers = seeder.layers;
+        if (layers.empty())
+        {
+            for (auto& layer : map->layers().ofType<TileLayer>())
+                if (layer->isOpen())
+                    layers.push_back(layer);
+        }
+        if (layers.size() != 1)
+            return error("Exporting to MBTiles requires a single layer; use --layer to pick one");
+
+        bool elevation = std::dynamic_pointer_cast<ElevationLayer>(layers.front()) != nullptr;
+
+        MBTiles::Options options;
+        options.uri = URI(arg);
+        options.format = elevation ? std::string("image/tif") : std::string("image/png");
+
+        // make sure we can actually encode tiles before seeding anything:
+        auto probe = Image::create(elevation ? Image::R32_SFLOAT : Image::R8G8B8A8_UNORM, 1, 1);
+        probe->fill(glm::fvec4(0.0f));
+        std::stringstream probe_buf;
+        auto probe_status = io.services.writeImageToStream(probe, probe_buf, options.format, io);
+        if (probe_status.failed())
+            return error("Cannot encode " + options.format.value() + " tiles for MBTiles : " + probe_status.message);
+
+        Profile profile = map->profile();
+        DataExtentList dataExtents;
+        auto status = mbtiles.open("rseed", options, true, profile, dataExtents, io);
+        if (status.failed())
+            return error("Failed to open \"" + arg + "\" : " + status.message);
+
+        seeder.layers = layers;
+        seeder.onTile = [&](const TileLayer*, const TileKey& key, shared_ptr<Image> image)
+            {
+                auto r = mbtiles.write(key, image, io);
+                if (r.failed())
+                    Log()->warn("Failed to write " + key.str() + " to MBTiles : " + r.message);
+            };
+
+        // writes are committed in batches; commit them before the checkpoint
+        // claims them, or an interrupted run would lose them for good.
+        seeder.onCheckpoint = [&]()
+            {
+                mbtiles.flush();
+            };
+    }
+#endif
+
+    if ((!io.services.cache || !io.services.cache()) && !seeder.onTile)
+        return error("Nowhere to put the tiles; use --cache (or set ROCKY_CACHE_PATH)");
+
+    auto start = std::chrono::steady_clock::now();
+
+    seeder.onProgress = [&](const TileSeeder::Progress& p)
+        {
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double pct = p.total > 0 ? 100.0 * (double)p.completed / (double)p.total : 100.0;
+            std::cout
+                << "\rLevel " << p.level
+                << " : " << p.completed << "/" << p.total << " keys (" << (int)pct << "%)"
+                << ", " << p.created << " tiles"
+                << ", " << p.failed << " errors"
+                << ", " << (int)elapsed << "s     " << std::flush;
+            return true;
+        };
+
+    auto status = seeder.run(map.get(), io);
+    std::cout << std::endl;
+
+#ifdef ROCKY_HAS_MBTILES
+    mbtiles.close();
+#endif
+
+    if (status.failed())
+        return error("Seeding failed : " + status.message);
+
+    return 0;
+}
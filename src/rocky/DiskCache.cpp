@@ -0,0 +1,124 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#include "DiskCache.h"
+#include "Utils.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace ROCKY_NAMESPACE;
+using namespace ROCKY_NAMESPACE::util;
+
+namespace
+{
+    // Every record file starts with this header.
+    struct RecordHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::int64_t lastModified;
+    };
+
+    constexpr std::uint32_t RECORD_MAGIC = 0x31434b52; // "RKC1"
+    constexpr std::uint32_t RECORD_VERSION = 1;
+    const std::string RECORD_EXTENSION = ".rkc";
+}
+
+DiskCache::DiskCache(const std::string& rootPath) :
+    super(),
+    _rootPath(rootPath)
+{
+    //nop
+}
+
+std::string
+DiskCache::pathOf(const std::string& bin, const std::string& key) const
+{
+    return
+        (std::filesystem::path(_rootPath) /
+        toLegalFileName(bin, false) /
+        (toLegalFileName(key, true) + RECORD_EXTENSION)).string();
+}
+
+Result<Cache::Record>
+DiskCache::read(const std::string& bin, const std::string& key) const
+{
+    std::ifstream in(pathOf(bin, key), std::ios_base::binary);
+    if (in.fail())
+        return Status(Status::ResourceUnavailable);
+
+    RecordHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (in.gcount() != sizeof(header) || header.magic != RECORD_MAGIC || header.version != RECORD_VERSION)
+        return Status(Status::ResourceUnavailable, "Invalid cache record");
+
+    Record record;
+    record.lastModified = static_cast<TimeStamp>(header.lastModified);
+    record.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return record;
+}
+
+Status
+DiskCache::write(const std::string& bin, const std::string& key, const std::string& data)
+{
+    std::filesystem::path path(pathOf(bin, key));
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec)
+        return Status(Status::ResourceUnavailable, ec.message());
+
+    // Write to a temporary file and then move it into place, so that a
+    // concurrent reader never sees a partially written record.
+    auto temp_path = path;
+    temp_path += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    std::ofstream out(temp_path, std::ios_base::binary | std::ios_base::trunc);
+    if (out.fail())
+        return Status(Status::ResourceUnavailable, "Cannot open " + temp_path.string());
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.version = RECORD_VERSION;
+    header.lastModified = static_cast<std::int64_t>(DateTime().asTimeStamp());
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(data.data(), data.size());
+    out.close();
+
+    if (out.fail())
+    {
+        std::filesystem::remove(temp_path, ec);
+        return Status(Status::ResourceUnavailable, "Failed to write " + temp_path.string());
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        return Status(Status::ResourceUnavailable, ec.message());
+    }
+
+    return StatusOK;
+}
+
+Status
+DiskCache::remove(const std::string& bin, const std::string& key)
+{
+    std::error_code ec;
+    std::filesystem::remove(pathOf(bin, key), ec);
+    return ec ? Status(Status::ResourceUnavailable, ec.message()) : StatusOK;
+}
+
+Status
+DiskCache::clear(const std::string& bin)
+{
+    std::error_code ec;
+    std::filesystem::remove_all(std::filesystem::path(_rootPath) / toLegalFileName(bin, false), ec);
+    return ec ? Status(Status::ResourceUnavailable, ec.message()) : StatusOK;
+}
@@ -0,0 +1,56 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#pragma once
+
+#include <rocky/IOTypes.h>
+
+namespace ROCKY_NAMESPACE
+{
+    /**
+     * Cache that stores each record in its own file under a root folder.
+     * Each bin gets its own subfolder, and keys containing a '/' (like
+     * TileKey strings) map to nested subfolders.
+     *
+     * Usage:
+     *   auto cache = DiskCache::create("/path/to/cache");
+     *   instance.ioOptions().services.cache = [cache]() { return cache; };
+     */
+    class ROCKY_EXPORT DiskCache : public Inherit<Cache, DiskCache>
+    {
+    public:
+        //! Construct a cache rooted at the given folder,
+        //! which is created on the first write if necessary.
+        DiskCache(const std::string& rootPath);
+
+        //! Root folder of the cache
+        const std::string& rootPath() const { return _rootPath; }
+
+        //! Delete all the records in a bin.
+        Status clear(const std::string& bin);
+
+    public: // Cache
+
+        Result<Record> read(
+            const std::string& bin,
+            const std::string& key) const override;
+
+        Status write(
+            const std::string& bin,
+            const std::string& key,
+            const std::string& data) override;
+
+        Status remove(
+            const std::string& bin,
+            const std::string& key) override;
+
+    private:
+        std::string _rootPath;
+
+        std::string pathOf(
+            const std::string& bin,
+            const std::string& key) const;
+    };
+}
@@ -6,10 +6,12 @@
 #include "ElevationLayer.h"
 #include "Geoid.h"
 #include "Heightfield.h"
+#include "Math.h"
 #include "Metrics.h"
 #include "json.h"
 
 #include <cinttypes>
+#include <numeric>
 
 using namespace ROCKY_NAMESPACE;
 using namespace ROCKY_NAMESPACE::util;
@@ -83,6 +85,7 @@ ElevationLayer::construct(const JSON& conf)
     }
 
     _L2cache.setCapacity(_l2cachesize.value());
+    _L2cache.plotNames = { "rocky.elevation_l2_cache.hits", "rocky.elevation_l2_cache.misses", "rocky.elevation_l2_cache.evictions" };
 
     // Disable max-level support for elevation data because it makes no sense.
     _maxLevel.clear();
@@ -357,9 +360,6 @@ ElevationLayer::createHeightfieldInKeyProfile(
     const TileKey& key,
     const IOOptions& io) const
 {
-    GeoHeightfield result;
-    shared_ptr<Heightfield> hf;
-
     auto my_profile = profile();
     if (!my_profile.valid() || !isOpen())
     {
@@ -372,50 +372,103 @@ ElevationLayer::createHeightfieldInKeyProfile(
         return Result(GeoHeightfield::INVALID);
     }
 
-    if (key.profile() == my_profile)
+    // Tiles created recently, e.g. the neighbors of a terrain tile
+    // sampled to build its normal map:
+    auto recent = _L2cache.get(key);
+    if (recent.status.ok() && recent.value.valid())
     {
-        std::shared_lock L(layerStateMutex());
-        auto r = createHeightfieldImplementation(key, io);
-
-        if (r.status.failed())
-            return r;
-        else
-            result = r.value;
-    }
-    else
-    {
-        // If the profiles are different, use a compositing method to assemble the tile.
-        shared_ptr<Heightfield> hf = assembleHeightfield(key, io);
-        result = GeoHeightfield(hf, key.extent());
+        return recent;
     }
 
-    // Check for cancelation before writing to a cache
-    if (io.canceled())
-    {
-        return Result(GeoHeightfield::INVALID);
-    }
+    // Only one thread creates any given key at a time; others asking for
+    // the same key wait for and share its result.
+    auto result = _inflight.run(key, [&]() -> Result<GeoHeightfield>
+        {
+            GeoHeightfield result;
+            shared_ptr<Heightfield> hf;
+
+            // Check the cache. An expired record is held in reserve in case
+            // the source is unavailable.
+            bool expired = false;
+            shared_ptr<Heightfield> cached_hf;
+            auto cached = readRasterFromCache(key, io, expired);
+            if (cached.status.ok() && cached.value->pixelFormat() == Image::R32_SFLOAT)
+            {
+                cached_hf = std::make_shared<Heightfield>(cached.value.get());
+            }
 
-    // The const_cast is safe here because we just created the
-    // heightfield from scratch...not from a cache.
-    hf = result.heightfield();
+            if (cached_hf && (!expired || isCacheOnly()))
+            {
+                return GeoHeightfield(cached_hf, key.extent());
+            }
 
-    // validate it to make sure it's legal.
-    if (hf && !validateHeightfield(hf.get()))
-    {
-        return Result<GeoHeightfield>(Status::GeneralError, "Generated an illegal heightfield!");
-    }
+            if (isCacheOnly())
+            {
+                return Result(GeoHeightfield::INVALID);
+            }
 
-    // Pre-caching operations:
-    normalizeNoDataValues(hf.get());
+            if (key.profile() == my_profile)
+            {
+                std::shared_lock L(layerStateMutex());
+                auto r = createHeightfieldImplementation(key, io);
+
+                if (r.status.failed())
+                {
+                    if (cached_hf)
+                        return GeoHeightfield(cached_hf, key.extent());
+                    else
+                        return r;
+                }
+                else
+                    result = r.value;
+            }
+            else
+            {
+                // If the profiles are different, use a compositing method to assemble the tile.
+                shared_ptr<Heightfield> hf = assembleHeightfield(key, io);
+                result = GeoHeightfield(hf, key.extent());
+            }
+
+            // Check for cancelation before writing to a cache
+            if (io.canceled())
+            {
+                return Result(GeoHeightfield::INVALID);
+            }
 
-    // No luck on any path:
-    if (hf == nullptr)
+            // The const_cast is safe here because we just created the
+            // heightfield from scratch...not from a cache.
+            hf = result.heightfield();
+
+            // validate it to make sure it's legal.
+            if (hf && !validateHeightfield(hf.get()))
+            {
+                return Result<GeoHeightfield>(Status::GeneralError, "Generated an illegal heightfield!");
+            }
+
+            // Pre-caching operations:
+            normalizeNoDataValues(hf.get());
+
+            // No luck on any path:
+            if (hf == nullptr)
+            {
+                if (cached_hf)
+                    return GeoHeightfield(cached_hf, key.extent());
+                else
+                    return Result(GeoHeightfield::INVALID);
+            }
+
+            writeRasterToCache(key, *hf, io);
+
+            result = GeoHeightfield(hf, key.extent());
+
+            return result;
+        }, &io);
+
+    if (result.status.ok() && result.value.valid() && !io.canceled())
     {
-        return Result(GeoHeightfield::INVALID);
+        _L2cache.put(key, result);
     }
 
-    result = GeoHeightfield(hf, key.extent());
-
     return result;
 }
 
@@ -428,7 +481,12 @@ ElevationLayer::writeHeightfield(
     if (isWritingSupported() && isWritingRequested())
     {
         std::shared_lock L(layerStateMutex());
-        return writeHeightfieldImplementation(key, hf, io);
+        auto status = writeHeightfieldImplementation(key, hf, io);
+        if (status.ok())
+        {
+            _L2cache.clear();
+        }
+        return status;
     }
     return Status(Status::ServiceUnavailable);
 }
@@ -457,6 +515,85 @@ namespace
 
     using LayerDataVector = std::vector<LayerData>;
 
+    // Samples a heightfield at a subset of the points of an output grid.
+    // Instead of resolving a transform for every sample, the points are
+    // transformed into the heightfield's SRS in one batch, and the texel
+    // lookup has everything it needs hoisted out of the loop.
+    void sampleHeightfield(
+        const GeoHeightfield& layerHF,
+        const std::vector<glm::dvec3>& grid,
+        const SRS& gridSRS,
+        const std::vector<unsigned>& indices,
+        Heightfield::Interpolation interpolation,
+        std::vector<float>& out_heights)
+    {
+        std::vector<glm::dvec3> local(indices.size());
+        for (std::size_t k = 0; k < indices.size(); ++k)
+        {
+            local[k] = grid[indices[k]];
+        }
+
+        SRSOperation xform;
+        if (gridSRS != layerHF.srs())
+        {
+            xform = gridSRS.to(layerHF.srs());
+            if (xform.valid())
+            {
+                // points that fail to transform land outside the extent
+                xform.transformArray(local.data(), local.size());
+            }
+        }
+
+        auto hf = layerHF.heightfield();
+        const GeoExtent& extent = layerHF.extent();
+        const double xmin = extent.xmin();
+        const double ymin = extent.ymin();
+        const double sx = 1.0 / layerHF.resolution().x;
+        const double sy = 1.0 / layerHF.resolution().y;
+        const double umax = (double)(hf->width() - 1);
+        const double vmax = (double)(hf->height() - 1);
+
+        for (auto& point : local)
+        {
+            if (extent.contains(point.x, point.y))
+            {
+                double u = clamp((point.x - xmin) * sx, 0.0, umax);
+                double v = clamp((point.y - ymin) * sy, 0.0, vmax);
+                point.z = hf->heightAtPixel(u, v, interpolation);
+            }
+            else
+            {
+                point.z = NO_DATA_VALUE;
+            }
+        }
+
+        if (xform.valid())
+        {
+            // bring the heights back into the vertical datum of the grid
+            std::vector<bool> valid(local.size());
+            for (std::size_t k = 0; k < local.size(); ++k)
+            {
+                valid[k] = local[k].z != NO_DATA_VALUE;
+                if (!valid[k])
+                    local[k].z = 0.0;
+            }
+
+            xform.inverseArray(local.data(), local.size());
+
+            for (std::size_t k = 0; k < local.size(); ++k)
+            {
+                out_heights[indices[k]] = valid[k] ? (float)local[k].z : NO_DATA_VALUE;
+            }
+        }
+        else
+        {
+            for (std::size_t k = 0; k < local.size(); ++k)
+            {
+                out_heights[indices[k]] = (float)local[k].z;
+            }
+        }
+    }
+
     void resolveInvalidHeights(
         Heightfield* grid,
         const GeoExtent&  ex,
@@ -646,8 +783,6 @@ ElevationLayerVector::populateHeightfield(
 
     int nodataCount = 0;
 
-    TileKey actualKey; // Storage if a new key needs to be constructed
-
     bool requiresResample = true;
 
     // If we only have a single contender layer, and the tile is the same size as the requested
@@ -688,180 +823,142 @@ ElevationLayerVector::populateHeightfield(
     // If we need to mosaic multiple layers or resample it to a new output tilesize go through a resampling loop.
     if (requiresResample)
     {
-        // We will load the actual heightfields on demand. We might not need them all.
-        std::vector<GeoHeightfield> heightfields(contenders.size());
-        std::vector<TileKey> heightfieldActualKeys(contenders.size());
-        std::vector<GeoHeightfield> offsetfields(offsets.size());
-        std::vector<bool> heightFallback(contenders.size(), false);
-        std::vector<bool> heightFailed(contenders.size(), false);
-        std::vector<bool> offsetFailed(offsets.size(), false);
-
-        // Initialize the actual keys to match the contender keys.
-        // We'll adjust these as necessary if we need to fall back
-        for(unsigned i=0; i<contenders.size(); ++i)
+        // The output sample locations, in the key's SRS. Sample s is at column s % numColumns
+        // and row s / numColumns, which is also its offset in the heightfield.
+        std::vector<glm::dvec3> grid(total);
+        for (unsigned r = 0; r < numRows; ++r)
         {
-            heightfieldActualKeys[i] = contenders[i].key;
+            double y = ymin + (dy * (double)r);
+            for (unsigned c = 0; c < numColumns; ++c)
+            {
+                grid[r * numColumns + c] = glm::dvec3(xmin + (dx * (double)c), y, 0.0);
+            }
         }
 
-        // The maximum number of heightfields to keep in this local cache
-        const unsigned maxHeightfields = 50;
-        unsigned numHeightfieldsInCache = 0;
+        std::vector<float> heights(total, NO_DATA_VALUE);
+        std::vector<float> sampleResolutions(total, FLT_MAX);
+        std::vector<int> resolvedIndex(total, -1);
 
-        for (unsigned c = 0; c < numColumns; ++c)
-        {
-            double x = xmin + (dx * (double)c);
+        // Samples that no layer has resolved yet
+        std::vector<unsigned> pending(total);
+        std::iota(pending.begin(), pending.end(), 0u);
 
-            // periodically check for cancelation
+        // Contenders are in priority order, so each one only has to fill in what the ones
+        // before it could not. Once a layer covers the whole tile, the rest are never loaded.
+        for (unsigned i = 0; i < contenders.size() && !pending.empty(); ++i)
+        {
             if (io.canceled())
             {
                 return false;
             }
 
-            for (unsigned r = 0; r < numRows; ++r)
-            {
-                double y = ymin + (dy * (double)r);
-
-                // Collect elevations from each layer as necessary.
-                int resolvedIndex = -1;
+            ElevationLayer* layer = contenders[i].layer.get();
+            TileKey& contenderKey = contenders[i].key;
 
-                float resolution = FLT_MAX;
+            // Fall back on parent keys to make sure that we have data at the location even if it's fallback.
+            GeoHeightfield layerHF;
+            TileKey actualKey = contenderKey;
+            while (!layerHF.valid() && actualKey.valid() && layer->isKeyInLegalRange(actualKey))
+            {
+                layerHF = layer->createHeightfield(actualKey, io).value;
+                if (!layerHF.valid())
+                {
+                    actualKey.makeParent();
+                }
+            }
 
-                glm::fvec3 normal_sum(0, 0, 0);
+            if (!layerHF.valid())
+                continue;
 
-                for (int i = 0; i < contenders.size() && resolvedIndex < 0; ++i)
-                {
-                    ElevationLayer* layer = contenders[i].layer.get();
-                    TileKey& contenderKey = contenders[i].key;
-                    int index = contenders[i].index;
+            // We only have real data if this is not a fallback heightfield.
+            //TODO: check this. Should it be actualKey != keyToUse...?
+            if (!contenders[i].isFallback && actualKey == contenderKey)
+            {
+                realData = true;
+            }
 
-                    if (heightFailed[i])
-                        continue;
+            sampleHeightfield(layerHF, grid, keySRS, pending, interpolation, heights);
 
-                    GeoHeightfield& layerHF = heightfields[i];
-                    TileKey& actualKey = heightfieldActualKeys[i];
+            float resolution = actualKey.getResolutionForTileSize(hf->width()).second;
 
-                    if (!layerHF.valid())
-                    {
-                        // We couldn't get the heightfield from the cache, so try to create it.
-                        // We also fallback on parent layers to make sure that we have data at the location even if it's fallback.
-                        while (!layerHF.valid() && actualKey.valid() && layer->isKeyInLegalRange(actualKey))
-                        {
-                            layerHF = layer->createHeightfield(actualKey, io).value;
-                            if (!layerHF.valid())
-                            {
-                                actualKey.makeParent();
-                            }
-                        }
-
-                        // Mark this layer as fallback if necessary.
-                        if (layerHF.valid())
-                        {
-                            //TODO: check this. Should it be actualKey != keyToUse...?
-                            heightFallback[i] =
-                                contenders[i].isFallback ||
-                                (actualKey != contenderKey);
-
-                            numHeightfieldsInCache++;
-                        }
-                        else
-                        {
-                            heightFailed[i] = true;
-                            continue;
-                        }
-                    }
+            std::size_t numPending = 0;
+            for (auto s : pending)
+            {
+                if (heights[s] != NO_DATA_VALUE)
+                {
+                    // remember the index so we can only apply offset layers that
+                    // sit on TOP of this layer.
+                    resolvedIndex[s] = contenders[i].index;
+                    sampleResolutions[s] = resolution;
+                }
+                else
+                {
+                    pending[numPending++] = s;
+                }
+            }
+            nodataCount += numPending;
+            pending.resize(numPending);
+        }
 
-                    if (layerHF.valid())
-                    {
-                        bool isFallback = heightFallback[i];
-
-                        // We only have real data if this is not a fallback heightfield.
-                        if (!isFallback)
-                        {
-                            realData = true;
-                        }
-
-                        //TODO: optimize by using SRSOperation variant
-                        float elevation = layerHF.heightAt(x, y, keySRS, interpolation);
-                        if (elevation != NO_DATA_VALUE)
-                        {
-                            // remember the index so we can only apply offset layers that
-                            // sit on TOP of this layer.
-                            resolvedIndex = index;
-
-                            hf->write(glm::fvec4(elevation), c, r);
-
-                            resolution = actualKey.getResolutionForTileSize(hf->width()).second;
-                        }
-                        else
-                        {
-                            ++nodataCount;
-                        }
-                    }
+        float* data = hf->data<float>();
 
+        for (unsigned s = 0; s < total; ++s)
+        {
+            if (resolvedIndex[s] >= 0)
+                data[s] = heights[s];
+        }
 
-                    // Clear the heightfield cache if we have too many heightfields in the cache.
-                    if (numHeightfieldsInCache >= maxHeightfields)
-                    {
-                        //OE_NOTICE << "Clearing cache" << std::endl;
-                        for (unsigned int k = 0; k < heightfields.size(); k++)
-                        {
-                            heightfields[k] = GeoHeightfield::INVALID;
-                            heightFallback[k] = false;
-                        }
-                        numHeightfieldsInCache = 0;
-                    }
-                }
+        std::vector<unsigned> targets;
+        targets.reserve(total);
 
-                for (int i = offsets.size() - 1; i >= 0; --i)
-                {
-                    if (io.canceled())
-                        return false;
+        for (int i = offsets.size() - 1; i >= 0; --i)
+        {
+            if (io.canceled())
+                return false;
 
-                    // Only apply an offset layer if it sits on top of the resolved layer
-                    // (or if there was no resolved layer).
-                    if (resolvedIndex >= 0 && offsets[i].index < resolvedIndex)
-                        continue;
+            // Only apply an offset layer if it sits on top of the resolved layer
+            // (or if there was no resolved layer).
+            targets.clear();
+            for (unsigned s = 0; s < total; ++s)
+            {
+                if (resolvedIndex[s] < 0 || offsets[i].index >= resolvedIndex[s])
+                    targets.push_back(s);
+            }
 
-                    TileKey& contenderKey = offsets[i].key;
+            if (targets.empty())
+                continue;
 
-                    if (offsetFailed[i] == true)
-                        continue;
+            TileKey& contenderKey = offsets[i].key;
 
-                    GeoHeightfield& layerHF = offsetfields[i];
-                    if (!layerHF.valid())
-                    {
-                        ElevationLayer* offset = offsets[i].layer.get();
-
-                        layerHF = offset->createHeightfield(contenderKey, io).value;
-                        if (!layerHF.valid())
-                        {
-                            offsetFailed[i] = true;
-                            continue;
-                        }
-                    }
+            auto layerHF = offsets[i].layer->createHeightfield(contenderKey, io).value;
+            if (!layerHF.valid())
+                continue;
 
-                    // If we actually got a layer then we have real data
-                    realData = true;
+            // If we actually got a layer then we have real data
+            realData = true;
 
-                    float elevation = layerHF.heightAt(x, y, keySRS, interpolation);
-                    if (elevation != NO_DATA_VALUE && !equiv(elevation, 0.0f))
-                    {
-                        hf->heightAt(c, r) += elevation;
+            std::fill(heights.begin(), heights.end(), NO_DATA_VALUE);
+            sampleHeightfield(layerHF, grid, keySRS, targets, interpolation, heights);
 
-                        // Technically this is correct, but the resultin normal maps
-                        // look awful and faceted.
-                        resolution = std::min(
-                            resolution,
-                            (float)contenderKey.getResolutionForTileSize(hf->width()).second);
-                    }
-                }
+            // Technically this is correct, but the resultin normal maps
+            // look awful and faceted.
+            float resolution = (float)contenderKey.getResolutionForTileSize(hf->width()).second;
 
-                if (resolutions)
+            for (auto s : targets)
+            {
+                float elevation = heights[s];
+                if (elevation != NO_DATA_VALUE && !equiv(elevation, 0.0f))
                 {
-                    (*resolutions)[r*numColumns+c] = resolution;
+                    data[s] += elevation;
+                    sampleResolutions[s] = std::min(sampleResolutions[s], resolution);
                 }
             }
         }
+
+        if (resolutions)
+        {
+            std::copy(sampleResolutions.begin(), sampleResolutions.end(), resolutions->begin());
+        }
     }
 
     // Resolve any invalid heights in the output heightfield.
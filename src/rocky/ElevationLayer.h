@@ -130,7 +130,8 @@ namespace ROCKY_NAMESPACE
         void normalizeNoDataValues(
             Heightfield* hf) const;
 
-        util::Gate<TileKey> _sentry;
+        // Shares the result among concurrent requests for the same key
+        mutable util::Coalescer<TileKey, Result<GeoHeightfield>> _inflight;
 
         mutable util::LRUCache<TileKey, Result<GeoHeightfield>> _L2cache;
     };
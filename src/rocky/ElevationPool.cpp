@@ -0,0 +1,288 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#include "ElevationPool.h"
+#include "ElevationLayer.h"
+#include "Heightfield.h"
+#include "Map.h"
+#include "Math.h"
+#include "Metrics.h"
+
+#include <unordered_map>
+
+using namespace ROCKY_NAMESPACE;
+
+#define LC "[ElevationPool] "
+
+namespace
+{
+    const std::size_t default_memory_budget = 64u * 1024u * 1024u;
+    const unsigned cache_shards = 4u;
+
+    std::size_t sizeOf(const GeoHeightfield& tile)
+    {
+        return tile.valid() ? tile.heightfield()->sizeInBytes() : 0u;
+    }
+
+    // Bilinear samples of one tile at a subset of the points. Everything the
+    // loop needs is hoisted out of it, and the common case (four valid
+    // neighbors) is branch-free arithmetic on the raw height grid.
+    void sampleTile(
+        const GeoHeightfield& tile,
+        const std::vector<glm::dvec3>& points,
+        const std::vector<unsigned>& indices,
+        std::vector<float>& out_heights)
+    {
+        auto hf = tile.heightfield();
+        const int cols = (int)hf->width();
+        const int rows = (int)hf->height();
+
+        if (cols < 2 || rows < 2)
+        {
+            for (auto i : indices)
+                out_heights[i] = tile.heightAtLocation(points[i].x, points[i].y, Image::BILINEAR);
+            return;
+        }
+
+        const double xmin = tile.extent().xmin();
+        const double ymin = tile.extent().ymin();
+        const double sx = (double)(cols - 1) / tile.extent().width();
+        const double sy = (double)(rows - 1) / tile.extent().height();
+        const double umax = (double)(cols - 1);
+        const double vmax = (double)(rows - 1);
+        const float* grid = hf->data<float>();
+
+        for (auto i : indices)
+        {
+            // texel coordinates; clamp the 2x2 footprint to the grid
+            double u = clamp((points[i].x - xmin) * sx, 0.0, umax);
+            double v = clamp((points[i].y - ymin) * sy, 0.0, vmax);
+            int c = std::min((int)u, cols - 2);
+            int r = std::min((int)v, rows - 2);
+            float fu = (float)(u - (double)c);
+            float fv = (float)(v - (double)r);
+
+            const float* p = grid + r * cols + c;
+            float h00 = p[0], h10 = p[1], h01 = p[cols], h11 = p[cols + 1];
+
+            if (h00 == NO_DATA_VALUE || h10 == NO_DATA_VALUE || h01 == NO_DATA_VALUE || h11 == NO_DATA_VALUE)
+            {
+                // rare; let the heightfield work around the holes
+                out_heights[i] = hf->heightAtPixel(u, v, Image::BILINEAR);
+            }
+            else
+            {
+                float h0 = h00 + (h10 - h00) * fu;
+                float h1 = h01 + (h11 - h01) * fu;
+                out_heights[i] = h0 + (h1 - h0) * fv;
+            }
+        }
+    }
+}
+
+ElevationPool::ElevationPool(const Map* map) :
+    _map(map),
+    _tiles(default_memory_budget, cache_shards, sizeOf)
+{
+    _tiles.plotNames = { "rocky.elevation_pool.hits", "rocky.elevation_pool.misses", "rocky.elevation_pool.evictions" };
+}
+
+void
+ElevationPool::setLevelOfDetail(unsigned value)
+{
+    if (value != _lod)
+    {
+        _lod = value;
+        _tiles.clear();
+    }
+}
+
+unsigned
+ElevationPool::levelOfDetail() const
+{
+    return _lod;
+}
+
+void
+ElevationPool::setMemoryBudget(std::size_t bytes)
+{
+    _tiles.setCapacity(bytes);
+}
+
+std::size_t
+ElevationPool::memoryBudget() const
+{
+    return _tiles.capacity();
+}
+
+void
+ElevationPool::clear()
+{
+    _tiles.clear();
+}
+
+util::LRUCache<TileKey, GeoHeightfield>::Metrics
+ElevationPool::metrics() const
+{
+    return _tiles.metrics();
+}
+
+void
+ElevationPool::sync() const
+{
+    // tiles composited from an older set of layers are stale:
+    Revision revision = _map->revision();
+    if (_mapRevision.exchange(revision) != revision)
+    {
+        _tiles.clear();
+    }
+}
+
+GeoHeightfield
+ElevationPool::getTile(const TileKey& key, const IOOptions& io) const
+{
+    auto tile = _tiles.get(key);
+    if (tile.valid())
+        return tile;
+
+    // Only one thread composites any given key at a time; others asking for
+    // the same key wait for and share its result.
+    return _inflight.run(key, [&]() -> GeoHeightfield
+        {
+            ElevationLayerVector layers;
+            for (auto& layer : _map->layers().ofType<ElevationLayer>())
+            {
+                if (layer->isOpen())
+                    layers.push_back(layer);
+            }
+
+            if (layers.empty())
+                return GeoHeightfield::INVALID;
+
+            GeoHeightfield result;
+
+            auto hf = Heightfield::create(_tileSize, _tileSize);
+            if (layers.populateHeightfield(hf, nullptr, key, Profile(), Image::BILINEAR, io))
+            {
+                result = GeoHeightfield(hf, key.extent());
+            }
+            else if (key.levelOfDetail() > 0 && !io.canceled())
+            {
+                // No real data at this level, so use the closest ancestor that has some.
+                // Caching it under this key too makes the budget count it twice, which
+                // only errs on the side of using less memory.
+                result = getTile(key.createParentKey(), io);
+            }
+
+            if (result.valid() && !io.canceled())
+            {
+                _tiles.put(key, result);
+            }
+
+            return result;
+        }, &io);
+}
+
+float
+ElevationPool::sample(const GeoPoint& point, const IOOptions& io) const
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(point.valid(), NO_DATA_VALUE);
+
+    std::vector<glm::dvec3> points{ { point.x, point.y, 0.0 } };
+    sample(points, point.srs, io);
+    return (float)points.front().z;
+}
+
+unsigned
+ElevationPool::sample(std::vector<glm::dvec3>& points, const SRS& srs, const IOOptions& io) const
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(_map && srs.valid(), 0u);
+
+    if (points.empty())
+        return 0u;
+
+    ROCKY_PROFILING_ZONE;
+
+    sync();
+
+    auto& profile = _map->profile();
+    auto xform = srs.to(profile.srs());
+    if (!xform.valid())
+    {
+        Log()->warn(LC "Cannot transform from " + std::string(srs.name()) + " to " + profile.srs().name());
+        return 0u;
+    }
+
+    // Transform all the points into the map's SRS at once. Zero the heights
+    // so the vertical datum shift comes out right on the way back.
+    std::vector<glm::dvec3> local(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        local[i] = glm::dvec3(points[i].x, points[i].y, 0.0);
+    }
+    xform.transformArray(local.data(), local.size());
+
+    // Group the points by the tile containing them, so we fetch each tile once:
+    std::unordered_map<TileKey, std::vector<unsigned>> groups;
+    for (unsigned i = 0; i < local.size(); ++i)
+    {
+        auto key = TileKey::createTileKeyContainingPoint(local[i].x, local[i].y, _lod, profile);
+        if (key.valid())
+        {
+            groups[key].push_back(i);
+        }
+    }
+
+    std::vector<float> heights(points.size(), NO_DATA_VALUE);
+
+    for (auto& [key, indices] : groups)
+    {
+        if (io.canceled())
+            break;
+
+        auto tile = getTile(key, io);
+        if (tile.valid())
+        {
+            sampleTile(tile, local, indices, heights);
+        }
+    }
+
+    // Bring the heights back into the vertical datum of the caller's SRS:
+    for (std::size_t i = 0; i < local.size(); ++i)
+    {
+        local[i].z = heights[i] != NO_DATA_VALUE ? (double)heights[i] : 0.0;
+    }
+    xform.inverseArray(local.data(), local.size());
+
+    unsigned count = 0u;
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        if (heights[i] != NO_DATA_VALUE)
+        {
+            points[i].z = local[i].z;
+            ++count;
+        }
+        else
+        {
+            points[i].z = NO_DATA_VALUE;
+        }
+    }
+
+    return count;
+}
+
+jobs::future<std::vector<glm::dvec3>>
+ElevationPool::sampleAsync(std::vector<glm::dvec3> points, const SRS& srs, const IOOptions& in_io) const
+{
+    auto task = [this, points, srs, in_io](Cancelable& c) -> std::vector<glm::dvec3>
+        {
+            IOOptions io(in_io, c);
+            auto result = points;
+            sample(result, srs, io);
+            return result;
+        };
+
+    return jobs::dispatch(task, jobs::context{ "elevation sample", jobs::get_pool(schedulerName) });
+}
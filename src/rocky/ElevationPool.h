@@ -0,0 +1,105 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#pragma once
+
+#include <rocky/Common.h>
+#include <rocky/GeoHeightfield.h>
+#include <rocky/GeoPoint.h>
+#include <rocky/IOTypes.h>
+#include <rocky/LRUCache.h>
+#include <rocky/Threading.h>
+#include <rocky/TileKey.h>
+#include <atomic>
+#include <vector>
+
+namespace ROCKY_NAMESPACE
+{
+    class Map;
+
+    /**
+     * Samples the terrain height of a map at arbitrary points.
+     *
+     * The pool composites the map's elevation layers into heightfield tiles
+     * and keeps them in a memory-budgeted cache, so that repeated queries in
+     * the same area (clamping tracks, icons, labels...) don't go back to the
+     * layers. Batched queries group their points by tile, fetch each tile
+     * once, and sample all of its points in one pass.
+     *
+     * Usage:
+     *   std::vector<glm::dvec3> points = ...; // long, lat
+     *   map->elevationPool()->sample(points, SRS::WGS84, io);
+     *   // each point's z is now the terrain height
+     */
+    class ROCKY_EXPORT ElevationPool
+    {
+    public:
+        //! Construct a pool that samples the elevation layers of a map
+        explicit ElevationPool(const Map* map);
+
+        //! Level of detail at which to sample. Where the layers have no data
+        //! at this level, the pool falls back on lower levels. Default is 14
+        //! (about 5m between samples at the equator in a geodetic profile).
+        void setLevelOfDetail(unsigned value);
+        unsigned levelOfDetail() const;
+
+        //! Memory budget of the heightfield cache, in bytes. Changing it
+        //! empties the cache. Default is 64 MB.
+        void setMemoryBudget(std::size_t bytes);
+        std::size_t memoryBudget() const;
+
+        //! Samples the terrain height at a point.
+        //! @param point Location to sample, in any SRS
+        //! @param io IO options
+        //! @return Height in the vertical datum of the point's SRS,
+        //!   or NO_DATA_VALUE if there is no elevation data there
+        float sample(
+            const GeoPoint& point,
+            const IOOptions& io) const;
+
+        //! Samples the terrain height at many points at once, storing each
+        //! height in the point's z coordinate (NO_DATA_VALUE where there is
+        //! no elevation data).
+        //! @param points Points to sample
+        //! @param srs SRS of the points; heights are in its vertical datum
+        //! @param io IO options
+        //! @return Number of points that received a height
+        unsigned sample(
+            std::vector<glm::dvec3>& points,
+            const SRS& srs,
+            const IOOptions& io) const;
+
+        //! Same as sample(points, srs, io), but runs in the background.
+        //! The map must remain alive until the future resolves.
+        //! @return Future result holding the points with their heights
+        jobs::future<std::vector<glm::dvec3>> sampleAsync(
+            std::vector<glm::dvec3> points,
+            const SRS& srs,
+            const IOOptions& io) const;
+
+        //! Empties the heightfield cache
+        void clear();
+
+        //! Usage statistics of the heightfield cache
+        util::LRUCache<TileKey, GeoHeightfield>::Metrics metrics() const;
+
+        //! Name of the job pool that runs sampleAsync()
+        std::string schedulerName = "rocky.elevation";
+
+    private:
+        const Map* _map = nullptr;
+        unsigned _lod = 14u;
+        unsigned _tileSize = 257u;
+        mutable std::atomic<Revision> _mapRevision = { -1 };
+        mutable util::LRUCache<TileKey, GeoHeightfield> _tiles;
+        mutable util::Coalescer<TileKey, GeoHeightfield> _inflight;
+
+        //! Composited heightfield covering a key, or the closest ancestor with data
+        GeoHeightfield getTile(const TileKey& key, const IOOptions& io) const;
+
+        //! Empties the cache if the map changed since the last query
+        void sync() const;
+    };
+}
@@ -7,10 +7,15 @@
 #ifdef ROCKY_HAS_GDAL
 
 #include "ElevationLayer.h" // for NO_DATA_VALUE
+#include "Threading.h"
 #include <gdal.h>
 #include <gdalwarper.h>
 #include <ogr_spatialref.h>
 #include <filesystem>
+#include <algorithm>
+#include <set>
+#include <chrono>
+#include <thread>
 
 using namespace ROCKY_NAMESPACE;
 using namespace ROCKY_NAMESPACE::GDAL;
@@ -360,6 +365,116 @@ namespace ROCKY_NAMESPACE
             }
         }
 
+        // Finds the overview of a band with the lowest resolution that is still at
+        // least as fine as the requested downsampling factor. Returns the band
+        // itself if no overview qualifies.
+        GDALRasterBand* selectOverview(GDALRasterBand* band, double factor)
+        {
+            GDALRasterBand* best = band;
+            double best_factor = 1.0;
+
+            int count = band->GetOverviewCount();
+            for (int i = 0; i < count; ++i)
+            {
+                GDALRasterBand* overview = band->GetOverview(i);
+                if (overview && overview->GetXSize() > 0)
+                {
+                    double f = (double)band->GetXSize() / (double)overview->GetXSize();
+                    if (f > best_factor && f <= factor * 1.01)
+                    {
+                        best = overview;
+                        best_factor = f;
+                    }
+                }
+            }
+            return best;
+        }
+
+        // Builds external (.ovr) overviews for a raster file, halving the
+        // resolution until the whole raster fits in about one tile.
+        void buildOverviews(const std::string& filename, unsigned tileSize)
+        {
+            // Several layers (or reopens of one layer) can ask for the same file
+            // at once, and the builds would share temp files. Let only one run.
+            static std::mutex building_mutex;
+            static std::set<std::string> building;
+            {
+                std::scoped_lock lock(building_mutex);
+                if (!building.insert(filename).second)
+                    return;
+            }
+
+            struct Done {
+                const std::string& filename;
+                ~Done() {
+                    std::scoped_lock lock(building_mutex);
+                    building.erase(filename);
+                }
+            } done{ filename };
+
+            // Drivers keep opening the file while we work, so build the overviews
+            // in a temporary file and move it into place only once it's complete.
+            // GDAL names external overviews after their dataset, so build them for
+            // a VRT that wraps the file; the resulting .ovr fits the file as well.
+            // Open everything read-only so GDAL never rewrites the file itself.
+            const std::string ovr_filename = filename + ".ovr";
+            const std::string temp_vrt = filename + ".building.vrt";
+            const std::string temp_ovr = temp_vrt + ".ovr";
+
+            // left over from an interrupted build?
+            VSIUnlink(temp_ovr.c_str());
+
+            auto src = (GDALDataset*)GDALOpen(filename.c_str(), GA_ReadOnly);
+            if (!src)
+                return;
+
+            auto vrt_driver = GDALGetDriverByName("VRT");
+            auto vrt = vrt_driver ? GDALCreateCopy(vrt_driver, temp_vrt.c_str(), src, FALSE, nullptr, nullptr, nullptr) : nullptr;
+            GDALClose(src);
+            if (!vrt)
+            {
+                Log()->warn("[GDAL] Failed to build overviews for " + filename + " : " + CPLGetLastErrorMsg());
+                return;
+            }
+            GDALClose(vrt);
+
+            auto ds = (GDALDataset*)GDALOpen(temp_vrt.c_str(), GA_ReadOnly);
+            if (!ds)
+            {
+                VSIUnlink(temp_vrt.c_str());
+                return;
+            }
+
+            std::vector<int> levels;
+            int size = std::max(ds->GetRasterXSize(), ds->GetRasterYSize());
+            for (int factor = 2; size / factor >= (int)tileSize; factor *= 2)
+                levels.push_back(factor);
+
+            CPLErr err = CE_Failure;
+            if (!levels.empty())
+            {
+                Log()->info("[GDAL] Building overviews for " + filename);
+
+                err = ds->BuildOverviews("AVERAGE", (int)levels.size(), levels.data(), 0, nullptr, nullptr, nullptr);
+
+                if (err != CE_None)
+                    Log()->warn("[GDAL] Failed to build overviews for " + filename + " : " + CPLGetLastErrorMsg());
+            }
+
+            GDALClose(ds);
+
+            if (err == CE_None)
+            {
+                if (VSIRename(temp_ovr.c_str(), ovr_filename.c_str()) == 0)
+                    Log()->info("[GDAL] Finished building overviews for " + filename);
+                else
+                    Log()->warn("[GDAL] Failed to move overviews into place at " + ovr_filename);
+            }
+
+            VSIUnlink(temp_ovr.c_str());
+            VSIUnlink(temp_vrt.c_str());
+        }
+
         // GDALRasterBand::RasterIO helper method
         bool rasterIO(
             GDALRasterBand *band,
@@ -401,13 +516,38 @@ namespace ROCKY_NAMESPACE
                 break;
             }
 
+            // When reading a large window into a smaller buffer, read from the
+            // coarsest overview that still has the buffer's resolution, so that
+            // low-LOD tiles don't touch full-resolution blocks.
+            GDALRasterBand* source = band;
+            if (eRWFlag == GF_Read && nBufXSize > 0 && nBufYSize > 0)
+            {
+                double factor = std::min(nXSize / (double)nBufXSize, nYSize / (double)nBufYSize);
+                if (factor > 1.0)
+                {
+                    source = selectOverview(band, factor);
+                    if (source != band)
+                    {
+                        double sx = (double)source->GetXSize() / (double)band->GetXSize();
+                        double sy = (double)source->GetYSize() / (double)band->GetYSize();
+                        nXOff *= sx, nXSize *= sx;
+                        nYOff *= sy, nYSize *= sy;
+                    }
+                }
+            }
+
             psExtraArg.bFloatingPointWindowValidity = TRUE;
             psExtraArg.dfXOff = nXOff;
             psExtraArg.dfYOff = nYOff;
             psExtraArg.dfXSize = nXSize;
             psExtraArg.dfYSize = nYSize;
 
-            CPLErr err = band->RasterIO(eRWFlag, floor(nXOff), floor(nYOff), ceil(nXSize), ceil(nYSize), pData, nBufXSize, nBufYSize, eBufType, nPixelSpace, nLineSpace, &psExtraArg);
+            int xoff = (int)floor(nXOff), yoff = (int)floor(nYOff);
+            int xsize = (int)ceil(nXSize), ysize = (int)ceil(nYSize);
+            xsize = std::max(1, std::min(xsize, source->GetXSize() - xoff));
+            ysize = std::max(1, std::min(ysize, source->GetYSize() - yoff));
+
+            CPLErr err = source->RasterIO(eRWFlag, xoff, yoff, xsize, ysize, pData, nBufXSize, nBufYSize, eBufType, nPixelSpace, nLineSpace, &psExtraArg);
 
             if (err != CE_None)
             {
@@ -445,22 +585,36 @@ namespace ROCKY_NAMESPACE
         {
             shared_ptr<Image> result;
 
+            // GDAL only decodes from a dataset, so the tile goes through an
+            // in-memory /vsimem file. A direct PNG/JPEG decoder would skip the
+            // dataset setup, but the only ones rocky can reach are vsgXchange's,
+            // which the core library does not link.
+
             // generate a unique name for our temporary vsimem file:
             static std::atomic_int rgen(0);
             std::string filename = "/vsimem/temp" + std::to_string(rgen++);
 
-            // populate the "file" from our raw data
-            auto memfile = VSIFileFromMemBuffer(filename.c_str(), (GByte*)data, (vsi_l_offset)length, true);
+            // Expose our raw data as a "file" without copying it. GDAL does not
+            // take ownership, so the buffer just needs to outlive the dataset.
+            auto memfile = VSIFileFromMemBuffer(filename.c_str(), (GByte*)data, (vsi_l_offset)length, FALSE);
             if (memfile)
             {
+                // we only need the name; the dataset opens its own handle
+                VSIFCloseL(memfile);
+
                 const char* const drivers[] = { name.c_str(), nullptr };
 
+                // An empty sibling list stops GDAL from probing /vsimem for
+                // .aux.xml, world files, and other side-car files.
+                const char* const siblings[] = { nullptr };
+
+                // no driver name means let GDAL identify the format
                 GDALDataset* ds = (GDALDataset*)GDALOpenEx(
                     filename.c_str(),
-                    GA_ReadOnly,
-                    drivers,
+                    GDAL_OF_RASTER | GDAL_OF_READONLY,
+                    name.empty() ? nullptr : drivers,
                     nullptr,
-                    nullptr);
+                    siblings);
 
                 if (ds)
                 {
@@ -492,7 +646,6 @@ namespace ROCKY_NAMESPACE
                     {
                         result = Image::create(format, width, height);
                         auto data = result->data<unsigned char>();
-                        GSpacing spacing = result->numComponents();
                         
                         int offset = 0;
 
@@ -516,34 +669,128 @@ namespace ROCKY_NAMESPACE
                             auto value_scale = M->GetScale();
                             auto value_offset = M->GetOffset();
 
-                            M->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>() + (offset++), width, height, GDT_Float32, 0, 0, nullptr);
+                            M->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>(), width, height, GDT_Float32, 0, 0, nullptr);
 
-                            auto ptr = result->data<float>();
-                            for (int i = 0; i < width * height; ++i, ptr++)
-                                *ptr = *ptr * value_scale + value_offset;
+                            if (value_scale != 1.0 || value_offset != 0.0)
+                            {
+                                auto ptr = result->data<float>();
+                                for (int i = 0; i < width * height; ++i, ptr++)
+                                    *ptr = *ptr * value_scale + value_offset;
+                            }
                         }
                         else
                         {
-                            if (R)
-                                R->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>() + (offset++), width, height, GDT_Byte, spacing, 0, nullptr);
-                            if (G)
-                                G->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>() + (offset++), width, height, GDT_Byte, spacing, 0, nullptr);
-                            if (B)
-                                B->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>() + (offset++), width, height, GDT_Byte, spacing, 0, nullptr);
-                            if (A)
-                                A->RasterIO(GF_Read, 0, 0, width, height, result->data<unsigned char>() + (offset++), width, height, GDT_Byte, spacing, 0, nullptr);
+                            // Decode every band in one pass, straight into the
+                            // interleaved pixels of the image, rather than one
+                            // strided read per band.
+                            int bandMap[4];
+                            int bandCount = 0;
+                            for (auto band : { R, G, B, A })
+                                if (band)
+                                    bandMap[bandCount++] = band->GetBand();
+
+                            GSpacing pixelSpace = result->numComponents();
+                            GSpacing lineSpace = pixelSpace * width;
+
+                            CPLErr err = ds->RasterIO(GF_Read, 0, 0, width, height, data, width, height, GDT_Byte,
+                                bandCount, bandMap, pixelSpace, lineSpace, 1, nullptr);
+
+                            if (err != CE_None)
+                                result = nullptr;
                         }
                     }
 
                     GDALClose(ds);
                 }
                 VSIUnlink(filename.c_str());
-                VSIFree(memfile);
             }
 
+            if (!result)
+                return Status(Status::ResourceUnavailable, "Failed to decode image");
+
             return result;
         }
 
+        Status writeImage(
+            shared_ptr<const Image> image,
+            std::ostream& out,
+            const std::string& name)
+        {
+            if (!image)
+                return Status(Status::AssertionFailure);
+
+            int bandCount =
+                image->pixelFormat() == Image::R8_UNORM ? 1 :
+                image->pixelFormat() == Image::R8G8B8_UNORM ? 3 :
+                image->pixelFormat() == Image::R8G8B8A8_UNORM ? 4 :
+                image->pixelFormat() == Image::R32_SFLOAT ? 1 :
+                0;
+
+            GDALDataType type = image->pixelFormat() == Image::R32_SFLOAT ? GDT_Float32 : GDT_Byte;
+
+            if (bandCount == 0)
+                return Status(Status::ServiceUnavailable, "No GDAL encoder for this pixel format");
+
+            auto encoder = (GDALDriver*)GDALGetDriverByName(name.c_str());
+            auto mem = (GDALDriver*)GDALGetDriverByName("MEM");
+            if (!encoder || !mem)
+                return Status(Status::ServiceUnavailable, "No GDAL encoder for \"" + name + "\"");
+
+            int width = image->width();
+            int height = image->height();
+
+            // Formats like PNG and JPEG only support CreateCopy, so stage
+            // the pixels in a MEM dataset first.
+            GDALDataset* src = mem->Create("", width, height, bandCount, type, nullptr);
+            if (!src)
+                return Status(Status::GeneralError, "Failed to create MEM dataset");
+
+            GSpacing bandSpace = image->componentSizeInBytes();
+            GSpacing pixelSpace = bandSpace * bandCount;
+            GSpacing lineSpace = pixelSpace * width;
+
+            CPLErr err = src->RasterIO(GF_Write, 0, 0, width, height,
+                const_cast<unsigned char*>(image->data<unsigned char>()), width, height, type,
+                bandCount, nullptr, pixelSpace, lineSpace, bandSpace, nullptr);
+
+            if (err == CE_None && bandCount == 4)
+                src->GetRasterBand(4)->SetColorInterpretation(GCI_AlphaBand);
+
+            static std::atomic_int wgen(0);
+            std::string filename = "/vsimem/encode" + std::to_string(wgen++);
+
+            GDALDataset* dst = nullptr;
+            if (err == CE_None)
+                dst = encoder->CreateCopy(filename.c_str(), src, FALSE, nullptr, nullptr, nullptr);
+
+            GDALClose(src);
+
+            if (!dst)
+            {
+                VSIUnlink(filename.c_str());
+                return Status(Status::GeneralError, "Failed to encode image with GDAL driver \"" + name + "\"");
+            }
+
+            // closing the dataset flushes the encoded bytes to the memory file:
+            GDALClose(dst);
+
+            vsi_l_offset length = 0;
+            GByte* buffer = VSIGetMemFileBuffer(filename.c_str(), &length, TRUE);
+            if (buffer)
+            {
+                out.write((const char*)buffer, (std::streamsize)length);
+                CPLFree(buffer);
+            }
+
+            // remove the side-car .aux.xml the encoder may have written
+            VSIUnlink((filename + ".aux.xml").c_str());
+
+            if (!buffer || !out)
+                return Status(Status::GeneralError, "Failed to write encoded image");
+
+            return StatusOK;
+        }
+
     }
 } // namespace ROCKY_NAMESPACE::GDAL
 
@@ -556,7 +803,7 @@ GDAL::Driver::Driver() :
     _maxDataLevel(30),
     _linearUnits(1.0)
 {
-    _threadId = std::this_thread::get_id();
+    //nop
 }
 
 GDAL::Driver::~Driver()
@@ -899,6 +1146,30 @@ GDAL::Driver::open(
     // Get the linear units of the SRS for scaling elevation values
     _linearUnits = 1.0; // srs.getReportedLinearUnits();
 
+    // Without overviews, every zoomed-out tile reads full-resolution blocks.
+    // Report that (once, on the first open) and optionally fix it.
+    if (info && _srcDS->GetRasterCount() > 0 && _srcDS->GetRasterBand(1)->GetOverviewCount() == 0)
+    {
+        int size = std::max(_srcDS->GetRasterXSize(), _srcDS->GetRasterYSize());
+        if (size > (int)tileSize * 8)
+        {
+            if (layer->buildOverviews() == true && isFile && useExternalDataset == false)
+            {
+                std::string filename = _srcDS->GetDescription();
+                jobs::dispatch([filename, tileSize]()
+                    {
+                        buildOverviews(filename, tileSize);
+                    },
+                    jobs::context{ "build overviews " + filename, jobs::get_pool("rocky.gdal.overviews") });
+            }
+            else
+            {
+                Log()->info(LC "Raster has no overviews; zoomed-out tiles will read full-resolution data "
+                    "(build them with gdaladdo or set build_overviews)");
+            }
+        }
+    }
+
     return StatusOK;
 }
 
@@ -1527,6 +1798,200 @@ GDAL::Driver::createImage(
 }
 
 
+//...................................................................
+
+// One generation of the pool's drivers
+struct GDAL::DriverPool::Slots
+{
+    Slots(unsigned in_capacity) :
+        capacity(in_capacity),
+        idle(new std::atomic<Driver*>[in_capacity])
+    {
+        for (unsigned i = 0; i < capacity; ++i)
+            idle[i] = nullptr;
+    }
+
+    ~Slots()
+    {
+        for (unsigned i = 0; i < capacity; ++i)
+            delete idle[i].exchange(nullptr);
+    }
+
+    Driver* tryTakeIdle()
+    {
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            Driver* driver = idle[i].load(std::memory_order_relaxed);
+            if (driver && idle[i].compare_exchange_strong(driver, nullptr, std::memory_order_acquire))
+                return driver;
+        }
+        return nullptr;
+    }
+
+    const unsigned capacity;
+    std::unique_ptr<std::atomic<Driver*>[]> idle;
+    std::atomic<unsigned> size = { 0 };
+    std::atomic<bool> retired = { false }; // replaced by a newer generation
+};
+
+GDAL::DriverPool::Lease&
+GDAL::DriverPool::Lease::operator = (Lease&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        reset();
+        _pool = rhs._pool;
+        _slots = std::move(rhs._slots);
+        _driver = rhs._driver;
+        rhs._driver = nullptr;
+    }
+    return *this;
+}
+
+void
+GDAL::DriverPool::Lease::reset()
+{
+    if (_pool && _slots && _driver)
+        _pool->release(*_slots, _driver);
+    _driver = nullptr;
+    _slots = nullptr;
+}
+
+GDAL::DriverPool::DriverPool(unsigned capacity)
+{
+    reset(capacity);
+}
+
+GDAL::DriverPool::~DriverPool()
+{
+    auto slots = std::atomic_load(&_slots);
+    if (slots)
+        slots->retired = true;
+}
+
+void
+GDAL::DriverPool::reset(unsigned capacity)
+{
+    if (capacity == 0)
+        capacity = std::max(1u, std::thread::hardware_concurrency());
+
+    // Swap in a new generation. The old one closes its idle drivers once
+    // the last lease on it returns.
+    auto old = std::atomic_exchange(&_slots, std::make_shared<Slots>(capacity));
+    if (old)
+    {
+        old->retired = true;
+
+        // close the idle ones now rather than later:
+        while (auto driver = old->tryTakeIdle())
+            delete driver;
+    }
+
+    // wake up any waiters so they move to the new generation
+    if (_waiters > 0)
+    {
+        std::unique_lock lock(_waitMutex);
+        _waitCV.notify_all();
+    }
+}
+
+unsigned
+GDAL::DriverPool::capacity() const
+{
+    auto slots = std::atomic_load(&_slots);
+    return slots ? slots->capacity : 0u;
+}
+
+unsigned
+GDAL::DriverPool::size() const
+{
+    auto slots = std::atomic_load(&_slots);
+    return slots ? slots->size.load() : 0u;
+}
+
+bool
+GDAL::DriverPool::add(std::unique_ptr<Driver> driver)
+{
+    if (!driver)
+        return false;
+
+    auto slots = std::atomic_load(&_slots);
+
+    unsigned size = slots->size;
+    do {
+        if (size >= slots->capacity)
+            return false;
+    } while (!slots->size.compare_exchange_weak(size, size + 1));
+
+    release(*slots, driver.release());
+    return true;
+}
+
+void
+GDAL::DriverPool::release(Slots& slots, Driver* driver)
+{
+    // A driver from an older generation doesn't count against the current
+    // one and may have been opened with old settings; close it.
+    if (slots.retired)
+    {
+        delete driver;
+        --slots.size;
+        return;
+    }
+
+    // There are as many slots as the generation can have drivers,
+    // so there is always an empty one for a returning driver.
+    for (unsigned i = 0; ; i = (i + 1) % slots.capacity)
+    {
+        Driver* empty = nullptr;
+        if (slots.idle[i].compare_exchange_strong(empty, driver, std::memory_order_release))
+            break;
+    }
+
+    if (_waiters > 0)
+    {
+        std::unique_lock lock(_waitMutex);
+        _waitCV.notify_one();
+    }
+}
+
+GDAL::DriverPool::Lease
+GDAL::DriverPool::acquire(const Factory& factory)
+{
+    for(;;)
+    {
+        auto slots = std::atomic_load(&_slots);
+
+        if (auto driver = slots->tryTakeIdle())
+            return Lease(this, slots, driver);
+
+        // nothing idle; open another driver if there's room for one.
+        unsigned size = slots->size;
+        while (size < slots->capacity)
+        {
+            if (slots->size.compare_exchange_weak(size, size + 1))
+            {
+                auto driver = factory ? factory() : nullptr;
+                if (driver)
+                    return Lease(this, slots, driver.release());
+
+                // failed; give back the reservation
+                --slots->size;
+                return Lease();
+            }
+        }
+
+        // at capacity; wait for someone to return a driver. The timeout
+        // covers a release that happens between our scan and our wait.
+        ++_waiters;
+        {
+            std::unique_lock lock(_waitMutex);
+            _waitCV.wait_for(lock, std::chrono::milliseconds(5));
+        }
+        --_waiters;
+    }
+}
+
 //...................................................................
 
 void GDAL::LayerBase::setURI(const URI& value) {
@@ -1553,6 +2018,12 @@ void GDAL::LayerBase::setInterpolation(const Image::Interpolation& value) {
 const optional<Image::Interpolation>& GDAL::LayerBase::interpolation() const {
     return _interpolation;
 }
+void GDAL::LayerBase::setBuildOverviews(bool value) {
+    _buildOverviews = value;
+}
+const optional<bool>& GDAL::LayerBase::buildOverviews() const {
+    return _buildOverviews;
+}
 
 //......................................................................
 
@@ -12,6 +12,11 @@
 #include <rocky/Image.h>
 #include <rocky/GeoExtent.h>
 #include <rocky/TileKey.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 class GDALDataset;
 class GDALRasterBand;
@@ -51,12 +56,18 @@ namespace ROCKY_NAMESPACE
             void setInterpolation(const Image::Interpolation& value);
             const optional<Image::Interpolation>& interpolation() const;
 
+            //! Whether to build overviews in the background if the raster
+            //! doesn't have any (default is false)
+            void setBuildOverviews(bool value);
+            const optional<bool>& buildOverviews() const;
+
         protected:
             optional<URI> _uri = { };
             optional<std::string> _connection = { };
             optional<unsigned> _subDataSet = 0;
             optional<Image::Interpolation> _interpolation = Image::AVERAGE;
             optional<bool> _singleThreaded = false;
+            optional<bool> _buildOverviews = false;
         };
 
         /**
@@ -133,15 +144,105 @@ namespace ROCKY_NAMESPACE
             const LayerBase* _layer;
             shared_ptr<ExternalDataset> _external;
             std::string _name;
-            std::thread::id _threadId;
 
             const std::string& getName() const { return _name; }
         };
 
+        /**
+         * Bounded pool of opened drivers, shared by all the threads that read
+         * from one layer. A GDALDataset must only be used by one thread at a
+         * time, so each request checks a driver out for its duration and then
+         * returns it for the next request to reuse.
+         *
+         * Idle drivers sit in lock-free slots, so checking one out or in never
+         * takes a lock. A thread only waits when every driver is busy and the
+         * pool is already at capacity. Because the pool never opens more than
+         * "capacity" datasets, the file handles and the process-wide GDAL block
+         * cache are shared by a few datasets rather than one per thread.
+         *
+         * Each reset() starts a new generation of slots. Drivers leased from an
+         * older generation are closed when they come back instead of joining
+         * the new one, since they may have been opened with old settings.
+         */
+        class ROCKY_EXPORT DriverPool
+        {
+            struct Slots;
+
+        public:
+            //! Opens a new driver, or returns nullptr upon failure
+            using Factory = std::function<std::unique_ptr<Driver>()>;
+
+            //! A driver checked out of the pool. Returns it to the pool
+            //! when destroyed.
+            class Lease
+            {
+            public:
+                Lease() = default;
+                Lease(const Lease&) = delete;
+                Lease& operator = (const Lease&) = delete;
+                Lease(Lease&& rhs) noexcept : _pool(rhs._pool), _slots(std::move(rhs._slots)), _driver(rhs._driver) { rhs._driver = nullptr; }
+                Lease& operator = (Lease&& rhs) noexcept;
+                ~Lease() { reset(); }
+
+                Driver* operator -> () const { return _driver; }
+                Driver* get() const { return _driver; }
+                explicit operator bool() const { return _driver != nullptr; }
+
+                //! Returns the driver to the pool early
+                void reset();
+
+            private:
+                Lease(DriverPool* pool, std::shared_ptr<Slots> slots, Driver* driver) : _pool(pool), _slots(std::move(slots)), _driver(driver) { }
+                DriverPool* _pool = nullptr;
+                std::shared_ptr<Slots> _slots; // generation the driver belongs to
+                Driver* _driver = nullptr;
+                friend class DriverPool;
+            };
+
+            //! Construct a pool
+            //! @param capacity Maximum number of drivers (default = one per hardware thread)
+            DriverPool(unsigned capacity = 0);
+
+            ~DriverPool();
+
+            //! Closes all the idle drivers and starts a new generation with a
+            //! new capacity. Drivers still checked out close when they return.
+            void reset(unsigned capacity = 0);
+
+            //! Maximum number of open drivers
+            unsigned capacity() const;
+
+            //! Number of drivers currently open
+            unsigned size() const;
+
+            //! Adds an already opened driver to the pool, e.g. the one
+            //! used to open the layer. Returns false if the pool is full.
+            bool add(std::unique_ptr<Driver> driver);
+
+            //! Checks out an idle driver, opening a new one with the factory
+            //! if none is idle and the pool is below capacity, or waiting for
+            //! one to be returned otherwise.
+            //! @return Empty lease if the factory failed to open a driver
+            Lease acquire(const Factory& factory);
+
+        private:
+            std::shared_ptr<Slots> _slots; // current generation; use std::atomic_load/store
+            std::atomic<unsigned> _waiters = { 0 };
+            std::mutex _waitMutex;
+            std::condition_variable _waitCV;
+
+            void release(Slots& slots, Driver*);
+        };
+
         //! Reads an image from raw data using the specified GDAL driver.
         extern ROCKY_EXPORT Result<shared_ptr<Image>> readImage(
             unsigned char* data, unsigned len, const std::string& gdal_driver);
 
+        //! Encodes an 8-bit or R32_SFLOAT image to a stream using the specified
+        //! GDAL driver (e.g., "png", "jpeg", or "gtiff").
+        extern ROCKY_EXPORT Status writeImage(
+            shared_ptr<const Image> image, std::ostream& out, const std::string& gdal_driver);
+
     } // namespace GDAL
 
 } // namespace ROCKY_NAMESPACE
@@ -14,14 +14,14 @@ using namespace ROCKY_NAMESPACE::GDAL;
 namespace
 {
     template<typename T>
-    Status openOnThisThread(
+    Status openDriver(
         const T* layer,
-        shared_ptr<GDAL::Driver>& driver,
+        std::unique_ptr<GDAL::Driver>& driver,
         Profile* profile,
         DataExtentList* out_dataExtents,
         const IOOptions& io)
     {
-        driver = std::make_shared<GDAL::Driver>();
+        driver = std::make_unique<GDAL::Driver>();
 
         if (layer->maxDataLevel().has_value())
             driver->setMaxDataLevel(layer->maxDataLevel());
@@ -41,7 +41,10 @@ namespace
             io);
 
         if (status.failed())
+        {
+            driver = nullptr;
             return status;
+        }
 
         if (driver->profile().valid() && profile != nullptr)
         {
@@ -78,6 +81,7 @@ GDALElevationLayer::construct(const JSON& conf)
     if (temp == "nearest") _interpolation = Image::NEAREST;
     else if (temp == "bilinear") _interpolation = Image::BILINEAR;
     get_to(j, "single_threaded", _singleThreaded);
+    get_to(j, "build_overviews", _buildOverviews);
 
     setRenderType(RENDERTYPE_TERRAIN_SURFACE);
 }
@@ -94,6 +98,7 @@ GDALElevationLayer::to_json() const
     else if (_interpolation.has_value(Image::BILINEAR))
         set(j, "interpolation", "bilinear");
     set(j, "single_threaded", _singleThreaded);
+    set(j, "build_overviews", _buildOverviews);
     return j.dump();
 }
 
@@ -106,15 +111,16 @@ GDALElevationLayer::openImplementation(const IOOptions& io)
 
     Profile profile;
 
-    // GDAL thread-safety requirement: each thread requires a separate GDALDataSet.
-    // So we just encapsulate the entire setup once per thread.
+    // GDAL thread-safety requirement: a GDALDataSet may only be used by one
+    // thread at a time. So we keep a pool of opened drivers that each request
+    // checks out, starting with the one we open here.
     // https://trac.osgeo.org/gdal/wiki/FAQMiscellaneous#IstheGDALlibrarythread-safe
 
-    auto& driver = _drivers.value();
+    std::unique_ptr<GDAL::Driver> driver;
 
     DataExtentList dataExtents;
 
-    Status s = openOnThisThread(
+    Status s = openDriver(
         this,
         driver,
         &profile,
@@ -124,6 +130,9 @@ GDALElevationLayer::openImplementation(const IOOptions& io)
     if (s.failed())
         return s;
 
+    _drivers.reset(_singleThreaded == true ? 1u : 0u);
+    _drivers.add(std::move(driver));
+
     // if the driver generated a valid profile, set it.
     if (profile.valid())
     {
@@ -138,8 +147,8 @@ GDALElevationLayer::openImplementation(const IOOptions& io)
 void
 GDALElevationLayer::closeImplementation()
 {
-    // safely shut down all per-thread handles.
-    _drivers.clear();
+    // safely shut down all the pooled drivers.
+    _drivers.reset();
 
     super::closeImplementation();
 }
@@ -154,13 +163,14 @@ GDALElevationLayer::createHeightfieldImplementation(
     if (status().failed())
         return status();
 
-    auto& driver = _drivers.value();
-    if (driver == nullptr)
-    {
-        // calling openImpl with NULL params limits the setup
-        // since we already called this during openImplementation
-        openOnThisThread(this, driver, nullptr, nullptr, io);
-    }
+    auto driver = _drivers.acquire([&]()
+        {
+            // calling openDriver with NULL params limits the setup
+            // since we already called this during openImplementation
+            std::unique_ptr<GDAL::Driver> driver;
+            openDriver(this, driver, nullptr, nullptr, io);
+            return driver;
+        });
 
     if (driver)
     {
@@ -45,7 +45,7 @@ namespace ROCKY_NAMESPACE
         //! Called by the constructors
         void construct(const JSON&);
 
-        mutable util::ThreadLocal<shared_ptr<GDAL::Driver>> _drivers;
+        mutable GDAL::DriverPool _drivers;
         friend class GDAL::Driver;
     };
 
@@ -16,14 +16,14 @@ using namespace ROCKY_NAMESPACE::GDAL;
 namespace
 {
     template<typename T>
-    Status openOnThisThread(
+    Status openDriver(
         const T* layer,
-        shared_ptr<GDAL::Driver>& driver,
+        std::unique_ptr<GDAL::Driver>& driver,
         Profile* profile,
         DataExtentList* out_dataExtents,
         const IOOptions& io)
     {
-        driver = std::make_shared<GDAL::Driver>();
+        driver = std::make_unique<GDAL::Driver>();
 
         if (layer->maxDataLevel().has_value())
             driver->setMaxDataLevel(layer->maxDataLevel());
@@ -36,7 +36,10 @@ namespace
             io);
 
         if (status.failed())
+        {
+            driver = nullptr;
             return status;
+        }
 
         if (driver->profile().valid() && profile != nullptr)
         {
@@ -73,6 +76,7 @@ GDALImageLayer::construct(const JSON& conf)
     if (temp == "nearest") _interpolation = Image::NEAREST;
     else if (temp == "bilinear") _interpolation = Image::BILINEAR;
     get_to(j, "single_threaded", _singleThreaded);
+    get_to(j, "build_overviews", _buildOverviews);
 
     setRenderType(RENDERTYPE_TERRAIN_SURFACE);
 }
@@ -89,6 +93,7 @@ GDALImageLayer::to_json() const
     else if (_interpolation.has_value(Image::BILINEAR))
         set(j, "interpolation", "bilinear");
     set(j, "single_threaded", _singleThreaded);
+    set(j, "build_overviews", _buildOverviews);
     return j.dump();
 }
 
@@ -101,15 +106,16 @@ GDALImageLayer::openImplementation(const IOOptions& io)
 
     Profile profile;
 
-    // GDAL thread-safety requirement: each thread requires a separate GDALDataSet.
-    // So we just encapsulate the entire setup once per thread.
+    // GDAL thread-safety requirement: a GDALDataSet may only be used by one
+    // thread at a time. So we keep a pool of opened drivers that each request
+    // checks out, starting with the one we open here.
     // https://trac.osgeo.org/gdal/wiki/FAQMiscellaneous#IstheGDALlibrarythread-safe
 
-    auto& driver = _drivers.value();
+    std::unique_ptr<GDAL::Driver> driver;
 
     DataExtentList dataExtents;
 
-    Status s = openOnThisThread(
+    Status s = openDriver(
         this,
         driver,
         &profile,
@@ -119,6 +125,9 @@ GDALImageLayer::openImplementation(const IOOptions& io)
     if (s.failed())
         return s;
 
+    _drivers.reset(_singleThreaded == true ? 1u : 0u);
+    _drivers.add(std::move(driver));
+
     // if the driver generated a valid profile, set it.
     if (profile.valid())
     {
@@ -133,8 +142,8 @@ GDALImageLayer::openImplementation(const IOOptions& io)
 void
 GDALImageLayer::closeImplementation()
 {
-    // safely shut down all per-thread handles.
-    _drivers.clear();
+    // safely shut down all the pooled drivers.
+    _drivers.reset();
 
     super::closeImplementation();
 }
@@ -149,13 +158,14 @@ GDALImageLayer::createImageImplementation(
     if (status().failed())
         return status();
 
-    auto& driver = _drivers.value();
-    if (driver == nullptr)
-    {
-        // calling openImpl with NULL params limits the setup
-        // since we already called this during openImplementation
-        openOnThisThread(this, driver, nullptr, nullptr, io);
-    }
+    auto driver = _drivers.acquire([&]()
+        {
+            // calling openDriver with NULL params limits the setup
+            // since we already called this during openImplementation
+            std::unique_ptr<GDAL::Driver> driver;
+            openDriver(this, driver, nullptr, nullptr, io);
+            return driver;
+        });
 
     if (driver)
     {
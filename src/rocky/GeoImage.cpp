@@ -2,6 +2,7 @@
 #include "Math.h"
 #include "Image.h"
 #include "Metrics.h"
+#include <cmath>
 
 #ifdef ROCKY_HAS_GDAL
 #include <gdal.h>
@@ -742,27 +743,132 @@ GeoImage::reproject(
 void
 GeoImage::composite(const std::vector<GeoImage>& sources)
 {
-    double x, y;
+    ROCKY_SOFT_ASSERT_AND_RETURN(valid(), void());
+
+    if (sources.empty())
+        return;
+
+    const unsigned width = _image->width();
+    const unsigned height = _image->height();
+
+    // Maps each of our texels to normalized (u,v) coordinates in one source.
+    // Sources in an equivalent SRS use a linear mapping; the others transform
+    // all the texel coordinates in one batch the first time they're needed,
+    // instead of resolving and running an SRS transform for every pixel.
+    struct Mapping
+    {
+        const GeoImage* source = nullptr;
+        bool hasAlpha = false;
+        bool linear = true;
+        bool initialized = false;
+        double u0 = 0.0, du = 0.0, v0 = 0.0, dv = 0.0;
+        std::vector<glm::dvec3> uv;
+
+        inline bool get(unsigned s, unsigned t, unsigned width, double& u, double& v) const
+        {
+            if (linear)
+            {
+                u = u0 + du * (double)s;
+                v = v0 + dv * (double)t;
+            }
+            else
+            {
+                auto& c = uv[t * width + s];
+                u = c.x, v = c.y;
+            }
+            return u >= 0.0 && u <= 1.0 && v >= 0.0 && v <= 1.0;
+        }
+    };
+
+    std::vector<Mapping> mappings(sources.size());
+
+    auto initialize = [&](Mapping& m)
+    {
+        auto& source_extent = m.source->extent();
+
+        if (m.source->srs().isHorizEquivalentTo(srs()))
+        {
+            // u = (x - xmin') / width', where x = xmin + s * width / (cols - 1)
+            double sx = width > 1 ? _extent.width() / (double)(width - 1) : 0.0;
+            double sy = height > 1 ? _extent.height() / (double)(height - 1) : 0.0;
+            m.u0 = (_extent.xMin() - source_extent.xMin()) / source_extent.width();
+            m.du = sx / source_extent.width();
+            m.v0 = (_extent.yMin() - source_extent.yMin()) / source_extent.height();
+            m.dv = sy / source_extent.height();
+        }
+        else
+        {
+            m.linear = false;
+            m.uv.resize(width * height);
+
+            for (unsigned t = 0; t < height; ++t)
+                for (unsigned s = 0; s < width; ++s)
+                {
+                    auto& c = m.uv[t * width + s];
+                    getCoord(s, t, c.x, c.y);
+                    c.z = 0.0;
+                }
+
+            auto xform = srs().to(m.source->srs());
+            if (!xform.valid())
+            {
+                m.uv.assign(m.uv.size(), glm::dvec3(-1.0, -1.0, 0.0));
+            }
+            else
+            {
+                // failed points come back as HUGE_VAL and fall out of range below
+                xform.transformArray(m.uv.data(), m.uv.size());
+
+                for (auto& c : m.uv)
+                {
+                    c.x = (c.x - source_extent.xMin()) / source_extent.width();
+                    c.y = (c.y - source_extent.yMin()) / source_extent.height();
+                    if (!std::isfinite(c.x) || !std::isfinite(c.y))
+                        c.x = c.y = -1.0;
+                }
+            }
+        }
+        m.initialized = true;
+    };
+
+    for (unsigned i = 0; i < sources.size(); ++i)
+    {
+        mappings[i].source = &sources[i];
+        mappings[i].hasAlpha = sources[i].valid() && sources[i].image()->hasAlphaChannel();
+    }
+
+    const bool hasAlpha = _image->hasAlphaChannel();
+
     glm::fvec4 pixel;
-    for (unsigned t = 0; t < _image->width(); ++t)
+    double u, v;
+
+    for (unsigned t = 0; t < height; ++t)
     {
-        for(unsigned s = 0; s < _image->height(); ++s)
+        for (unsigned s = 0; s < width; ++s)
         {
             // read the existing pixel
             _image->read(pixel, s, t);
 
             // see if we need to overwrite it
-            if ((_image->hasAlphaChannel() && pixel.a < 1.0f) ||
+            if ((hasAlpha && pixel.a < 1.0f) ||
                 (pixel.r == 0.0f && pixel.g == 0.0f && pixel.b == 0.0f))
             {
-                getCoord(s, t, x, y);
                 for (int i = (int)sources.size() - 1; i >= 0; --i)
                 {
-                    auto& source = sources[i];
-                    source.read(pixel, x, y, srs());
+                    auto& m = mappings[i];
+                    if (!m.source->valid())
+                        continue;
+
+                    if (!m.initialized)
+                        initialize(m);
+
+                    if (!m.get(s, t, width, u, v))
+                        continue;
+
+                    m.source->image()->read_bilinear(pixel, (float)u, (float)v);
 
                     if ((i == 0) ||
-                        (source.image()->hasAlphaChannel() && pixel.a > 0.5f) ||
+                        (m.hasAlpha && pixel.a > 0.5f) ||
                         (pixel.r > 0.05f || pixel.g > 0.05f || pixel.b > 0.05f))
                     {
                         _image->write(pixel, s, t);
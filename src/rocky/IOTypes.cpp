@@ -68,10 +68,22 @@ CachePolicy::mergeAndOverride(const optional<CachePolicy>& rhs)
 DateTime
 CachePolicy::getMinAcceptTime() const
 {
-    return
-        minTime.has_value() ? minTime.value() :
-        maxAge.has_value() ? DateTime().asTimeStamp() - maxAge.value() :
-        0;
+    TimeStamp result = 0;
+
+    if (minTime.has_value())
+    {
+        result = minTime->asTimeStamp();
+    }
+
+    if (maxAge.has_value())
+    {
+        TimeStamp now = DateTime().asTimeStamp();
+        double age = maxAge->as(Units::SECONDS);
+        if (age < (double)now)
+            result = std::max(result, now - (TimeStamp)age);
+    }
+
+    return DateTime(result);
 }
 
 bool
@@ -128,8 +140,10 @@ IOOptions::IOOptions(Cancelable& c) :
 
 IOOptions::IOOptions(const IOOptions& rhs, Cancelable& c) :
     services(rhs.services),
-    _properties(rhs._properties),
-    _cancelable(&c)
+    maxNetworkAttempts(rhs.maxNetworkAttempts),
+    maxConnectionsPerHost(rhs.maxConnectionsPerHost),
+    _cancelable(&c),
+    _properties(rhs._properties)
 {
     //nop
 }
@@ -138,6 +152,8 @@ IOOptions&
 IOOptions::operator = (const IOOptions& rhs)
 {
     services = rhs.services;
+    maxNetworkAttempts = rhs.maxNetworkAttempts;
+    maxConnectionsPerHost = rhs.maxConnectionsPerHost;
     _cancelable = rhs._cancelable;
     _properties = rhs._properties;
     return *this;
@@ -147,12 +163,14 @@ namespace
 {
     ReadImageURIService default_read_image_from_uri = [](const std::string&, const IOOptions&) { return Status(Status::ServiceUnavailable); };
     ReadImageStreamService default_read_image_from_stream = [](std::istream&, const std::string&, const IOOptions&) { return Status(Status::ServiceUnavailable); };
+    WriteImageStreamService default_write_image_to_stream = [](shared_ptr<Image>, std::ostream&, const std::string&, const IOOptions&) { return Status(Status::ServiceUnavailable); };
     CacheService default_cache = []() { return nullptr; };
 }
 
 Services::Services() :
     readImageFromURI(default_read_image_from_uri),
     readImageFromStream(default_read_image_from_stream),
+    writeImageToStream(default_write_image_to_stream),
     cache(default_cache)
 {
     //nop
@@ -21,9 +21,40 @@ namespace ROCKY_NAMESPACE
     class Image;
     class Layer;
 
-    //! Base class for a cache
-    class Cache : public Inherit<Object, Cache>
+    /**
+     * Base class for a persistent data cache.
+     * Records are organized into "bins" (usually one per layer) and
+     * addressed by a string key that is unique within the bin.
+     * Implementations must be safe to call from multiple threads.
+     */
+    class ROCKY_EXPORT Cache : public Inherit<Object, Cache>
     {
+    public:
+        //! A single cached object
+        struct Record
+        {
+            std::string data;
+            TimeStamp lastModified = 0;
+        };
+
+        //! Reads a record from the cache.
+        //! @param bin Bin (namespace) containing the record
+        //! @param key Key of the record within the bin
+        //! @return Record, or a ResourceUnavailable status upon a miss
+        virtual Result<Record> read(
+            const std::string& bin,
+            const std::string& key) const = 0;
+
+        //! Writes a record to the cache, timestamping it with the current time.
+        virtual Status write(
+            const std::string& bin,
+            const std::string& key,
+            const std::string& data) = 0;
+
+        //! Removes a record from the cache.
+        virtual Status remove(
+            const std::string& bin,
+            const std::string& key) = 0;
     };
 
     //! Service for reading an image from a URL
@@ -37,8 +68,7 @@ namespace ROCKY_NAMESPACE
         Status(shared_ptr<Image> image, std::ostream& stream, std::string contentType, const IOOptions& io)>;
 
     //! Service for caching data
-    using CacheImpl = void*; // todo.
-    using CacheService = std::function<shared_ptr<CacheImpl>()>;
+    using CacheService = std::function<shared_ptr<Cache>()>;
 
     //! Service for accessing other data
     class DataInterface {
@@ -54,6 +84,21 @@ namespace ROCKY_NAMESPACE
 
     using ContentCache = rocky::util::LRUCache<std::string, Result<Content>>;
 
+    //! Creates a content cache budgeted by the total size of the content
+    //! it holds, split into independently locked shards. Content larger
+    //! than max_bytes / num_shards (4MB by default) is not cached.
+    inline shared_ptr<ContentCache> createContentCache(
+        std::size_t max_bytes = 64u * 1024u * 1024u,
+        unsigned num_shards = 16u)
+    {
+        auto cache = std::make_shared<ContentCache>(max_bytes, num_shards,
+            [](const Result<Content>& r) {
+                return r.value.data.size() + r.value.contentType.size() + sizeof(Result<Content>);
+            });
+        cache->plotNames = { "rocky.content_cache.hits", "rocky.content_cache.misses", "rocky.content_cache.evictions" };
+        return cache;
+    }
+
     class ROCKY_EXPORT Services
     {
     public:
@@ -62,7 +107,7 @@ namespace ROCKY_NAMESPACE
         ReadImageStreamService readImageFromStream;
         WriteImageStreamService writeImageToStream;
         CacheService cache;
-        shared_ptr<ContentCache> contentCache = std::make_shared<ContentCache>(128);
+        shared_ptr<ContentCache> contentCache = createContentCache();
     };
 
     // User options passed along with an IO context.
@@ -84,6 +129,10 @@ namespace ROCKY_NAMESPACE
         //! Maximum number of attempts to make a network connection
         unsigned maxNetworkAttempts = 4u;
 
+        //! Maximum number of simultaneous (keep-alive) connections to
+        //! any one HTTP server
+        unsigned maxConnectionsPerHost = 8u;
+
         //! Was the current operation canceled?
         inline bool canceled() const override;
 
@@ -4,6 +4,10 @@
  * MIT License
  */
 #include "Image.h"
+#include <cfloat>
+#include <climits>
+#include <cstdint>
+#include <type_traits>
 
 using namespace ROCKY_NAMESPACE;
 
@@ -59,18 +63,321 @@ namespace
                 *sptr++ = (T)pixel[i];
         }
     };
+
+    // Compressed pixels are read through Image::readCompressed,
+    // and cannot be written.
+    struct COMPRESSED {
+        static void read(Image::Pixel& pixel, unsigned char* ptr, int n) {
+            pixel = Image::Pixel(0.0f);
+        }
+        static void write(const Image::Pixel& pixel, unsigned char* ptr, int n) {
+            //nop
+        }
+    };
+
+    // Block compression (BC1 and BC3, a.k.a. DXT1 and DXT5).
+    // https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+    namespace bc
+    {
+        using block = std::uint8_t[16][4]; // 4x4 RGBA pixels
+
+        inline std::uint16_t to565(float r, float g, float b)
+        {
+            auto q = [](float v, int max) {
+                return (std::uint16_t)clamp((int)(v * (float)max / 255.0f + 0.5f), 0, max);
+            };
+            return (q(r, 31) << 11) | (q(g, 63) << 5) | q(b, 31);
+        }
+
+        inline void from565(std::uint16_t c, int* rgb)
+        {
+            int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+            rgb[0] = (r << 3) | (r >> 2);
+            rgb[1] = (g << 2) | (g >> 4);
+            rgb[2] = (b << 3) | (b >> 2);
+        }
+
+        // Palette of a BC1 color block. In 3-color mode,
+        // entry 3 is transparent black.
+        inline void colorPalette(std::uint16_t c0, std::uint16_t c1, bool four_color, int palette[4][4])
+        {
+            from565(c0, palette[0]);
+            from565(c1, palette[1]);
+            palette[0][3] = palette[1][3] = 255;
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (four_color)
+                {
+                    palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+                    palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+                }
+                else
+                {
+                    palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+                    palette[3][i] = 0;
+                }
+            }
+            palette[2][3] = 255;
+            palette[3][3] = four_color ? 255 : 0;
+        }
+
+        inline void alphaPalette(int a0, int a1, int palette[8])
+        {
+            palette[0] = a0;
+            palette[1] = a1;
+            if (a0 > a1)
+            {
+                for (int i = 1; i < 7; ++i)
+                    palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+            }
+            else
+            {
+                for (int i = 1; i < 5; ++i)
+                    palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        // Encodes the 8-byte color part of a block. Endpoints come from the
+        // extent of the pixels along their principal axis. If "punch_through"
+        // is set, pixels with alpha < 128 become transparent (BC1 only).
+        void encodeColor(const block& px, bool punch_through, std::uint8_t* out)
+        {
+            bool opaque[16];
+            int count = 0;
+            bool any_transparent = false;
+            float mean[3] = { 0, 0, 0 };
+
+            for (int i = 0; i < 16; ++i)
+            {
+                opaque[i] = !punch_through || px[i][3] >= 128;
+                if (opaque[i])
+                {
+                    for (int c = 0; c < 3; ++c) mean[c] += px[i][c];
+                    ++count;
+                }
+                else any_transparent = true;
+            }
+
+            std::uint16_t c0 = 0, c1 = 0;
+            std::uint32_t indices = 0;
+
+            if (count == 0)
+            {
+                // all transparent: 3-color mode, every index 3
+                indices = 0xFFFFFFFF;
+            }
+            else
+            {
+                for (int c = 0; c < 3; ++c) mean[c] /= (float)count;
+
+                // covariance of the colors
+                float cov[6] = { 0, 0, 0, 0, 0, 0 };
+                for (int i = 0; i < 16; ++i)
+                {
+                    if (!opaque[i]) continue;
+                    float r = px[i][0] - mean[0], g = px[i][1] - mean[1], b = px[i][2] - mean[2];
+                    cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+                    cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+                }
+
+                // principal axis by power iteration
+                float axis[3] = { 1.0f, 1.0f, 1.0f };
+                for (int iter = 0; iter < 4; ++iter)
+                {
+                    float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+                    float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+                    float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+                    float len = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+                    if (len <= 0.0f) break;
+                    axis[0] = x / len, axis[1] = y / len, axis[2] = z / len;
+                }
+                float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+                float tmin = 0.0f, tmax = 0.0f;
+                if (len2 > 0.0f)
+                {
+                    tmin = FLT_MAX, tmax = -FLT_MAX;
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        if (!opaque[i]) continue;
+                        float t = ((px[i][0] - mean[0]) * axis[0] + (px[i][1] - mean[1]) * axis[1] + (px[i][2] - mean[2]) * axis[2]) / len2;
+                        tmin = std::min(tmin, t);
+                        tmax = std::max(tmax, t);
+                    }
+                }
+
+                c0 = to565(mean[0] + axis[0] * tmax, mean[1] + axis[1] * tmax, mean[2] + axis[2] * tmax);
+                c1 = to565(mean[0] + axis[0] * tmin, mean[1] + axis[1] * tmin, mean[2] + axis[2] * tmin);
+
+                // c0 > c1 selects 4-color mode; c0 <= c1 selects 3-color + transparent.
+                bool four_color = !any_transparent;
+                if ((four_color && c0 < c1) || (!four_color && c0 > c1))
+                    std::swap(c0, c1);
+                if (four_color && c0 == c1)
+                    four_color = false; // all one color; index 0 in either mode
+
+                int palette[4][4];
+                colorPalette(c0, c1, four_color, palette);
+
+                for (int i = 15; i >= 0; --i)
+                {
+                    int best = 3;
+                    if (opaque[i])
+                    {
+                        int best_d = INT_MAX;
+                        for (int p = 0; p < (four_color ? 4 : 3); ++p)
+                        {
+                            int dr = px[i][0] - palette[p][0], dg = px[i][1] - palette[p][1], db = px[i][2] - palette[p][2];
+                            int d = dr * dr + dg * dg + db * db;
+                            if (d < best_d) best_d = d, best = p;
+                        }
+                    }
+                    indices = (indices << 2) | (std::uint32_t)best;
+                }
+            }
+
+            out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+            out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+            for (int i = 0; i < 4; ++i)
+                out[4 + i] = (indices >> (8 * i)) & 0xFF;
+        }
+
+        // Encodes the 8-byte alpha part of a BC3 block.
+        void encodeAlpha(const block& px, std::uint8_t* out)
+        {
+            int a0 = 0, a1 = 255;
+            for (int i = 0; i < 16; ++i)
+            {
+                a0 = std::max(a0, (int)px[i][3]);
+                a1 = std::min(a1, (int)px[i][3]);
+            }
+
+            int palette[8];
+            alphaPalette(a0, a1, palette);
+
+            std::uint64_t indices = 0;
+            for (int i = 15; i >= 0; --i)
+            {
+                int best = 0, best_d = INT_MAX;
+                for (int p = 0; p < 8; ++p)
+                {
+                    int d = std::abs((int)px[i][3] - palette[p]);
+                    if (d < best_d) best_d = d, best = p;
+                }
+                indices = (indices << 3) | (std::uint64_t)best;
+            }
+
+            out[0] = (std::uint8_t)a0;
+            out[1] = (std::uint8_t)a1;
+            for (int i = 0; i < 6; ++i)
+                out[2 + i] = (indices >> (8 * i)) & 0xFF;
+        }
+
+        // Decodes one pixel (0..15) of a block.
+        void decode(const std::uint8_t* in, bool bc3, int i, Image::Pixel& pixel)
+        {
+            int alpha = 255;
+            if (bc3)
+            {
+                int palette[8];
+                alphaPalette(in[0], in[1], palette);
+                std::uint64_t indices = 0;
+                for (int b = 0; b < 6; ++b)
+                    indices |= (std::uint64_t)in[2 + b] << (8 * b);
+                alpha = palette[(indices >> (3 * i)) & 7];
+                in += 8;
+            }
+
+            std::uint16_t c0 = in[0] | (in[1] << 8);
+            std::uint16_t c1 = in[2] | (in[3] << 8);
+            std::uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((std::uint32_t)in[7] << 24);
+
+            int palette[4][4];
+            colorPalette(c0, c1, bc3 || c0 > c1, palette);
+            auto& c = palette[(indices >> (2 * i)) & 3];
+
+            pixel = Image::Pixel(c[0], c[1], c[2], bc3 ? alpha : c[3]) / 255.0f;
+        }
+    }
+
+    // Mipmap generation
+    namespace mip
+    {
+        // 2x2 box filter from one level to the next. The inner loop works on
+        // whole rows of interleaved components so the compiler can vectorize it.
+        // With an odd source dimension the last row/column is skipped,
+        // and a dimension of 1 stays 1.
+        // A = accumulator type wide enough to sum four T's.
+        template<typename T, typename A>
+        void box(const T* src, unsigned sw, unsigned sh, T* dst, unsigned dw, unsigned dh, unsigned nc)
+        {
+            const unsigned sx_step = sw > 1 ? 2 : 1;
+            const unsigned sy_step = sh > 1 ? 2 : 1;
+            const A rounding = std::is_integral<T>::value ? (A)2 : (A)0;
+
+            for (unsigned y = 0; y < dh; ++y)
+            {
+                const T* row0 = src + (y * sy_step) * sw * nc;
+                const T* row1 = sy_step > 1 ? row0 + sw * nc : row0;
+                T* out = dst + y * dw * nc;
+
+                for (unsigned x = 0; x < dw; ++x)
+                {
+                    const unsigned i0 = (x * sx_step) * nc;
+                    const unsigned i1 = sx_step > 1 ? i0 + nc : i0;
+                    for (unsigned c = 0; c < nc; ++c)
+                    {
+                        A sum = (A)row0[i0 + c] + (A)row0[i1 + c] + (A)row1[i0 + c] + (A)row1[i1 + c];
+                        out[x * nc + c] = (T)((sum + rounding) / (A)4);
+                    }
+                }
+            }
+        }
+
+        void downsample(Image::PixelFormat format,
+            const unsigned char* src, unsigned sw, unsigned sh,
+            unsigned char* dst, unsigned dw, unsigned dh,
+            unsigned nc)
+        {
+            switch (format)
+            {
+            case Image::R8_UNORM:
+            case Image::R8G8_UNORM:
+            case Image::R8G8B8_UNORM:
+            case Image::R8G8B8A8_UNORM:
+                box<std::uint8_t, std::uint32_t>(src, sw, sh, dst, dw, dh, nc);
+                break;
+            case Image::R16_UNORM:
+                box<std::uint16_t, std::uint32_t>((const std::uint16_t*)src, sw, sh, (std::uint16_t*)dst, dw, dh, nc);
+                break;
+            case Image::R32_SFLOAT:
+                box<float, float>((const float*)src, sw, sh, (float*)dst, dw, dh, nc);
+                break;
+            case Image::R64_SFLOAT:
+                box<double, double>((const double*)src, sw, sh, (double*)dst, dw, dh, nc);
+                break;
+            default:
+                break;
+            }
+        }
+    }
 }
 
 // static member
-Image::Layout Image::_layouts[7] =
-{
-    { &NORM8<uchar>::read, &NORM8<uchar>::write, 1, 1, R8_UNORM },
-    { &NORM8<uchar>::read, &NORM8<uchar>::write, 2, 2, R8G8_UNORM },
-    { &NORM8<uchar>::read, &NORM8<uchar>::write, 3, 3, R8G8B8_UNORM },
-    { &NORM8<uchar>::read, &NORM8<uchar>::write, 4, 4, R8G8B8A8_UNORM },
-    { &NORM16<ushort>::read, &NORM16<ushort>::write, 1, 2, R16_UNORM },
-    { &FLOAT<float>::read, &FLOAT<float>::write, 1, 4, R32_SFLOAT },
-    { &FLOAT<double>::read, &FLOAT<double>::write, 1, 8, R64_SFLOAT }
+Image::Layout Image::_layouts[NUM_PIXEL_FORMATS] =
+{
+    { &NORM8<uchar>::read, &NORM8<uchar>::write, 1, 1, R8_UNORM, 1, 1 },
+    { &NORM8<uchar>::read, &NORM8<uchar>::write, 2, 2, R8G8_UNORM, 1, 2 },
+    { &NORM8<uchar>::read, &NORM8<uchar>::write, 3, 3, R8G8B8_UNORM, 1, 3 },
+    { &NORM8<uchar>::read, &NORM8<uchar>::write, 4, 4, R8G8B8A8_UNORM, 1, 4 },
+    { &NORM16<ushort>::read, &NORM16<ushort>::write, 1, 2, R16_UNORM, 1, 2 },
+    { &FLOAT<float>::read, &FLOAT<float>::write, 1, 4, R32_SFLOAT, 1, 4 },
+    { &FLOAT<double>::read, &FLOAT<double>::write, 1, 8, R64_SFLOAT, 1, 8 },
+    { &COMPRESSED::read, &COMPRESSED::write, 4, 0, BC1_RGBA_UNORM, 4, 8 },
+    { &COMPRESSED::read, &COMPRESSED::write, 4, 0, BC3_UNORM, 4, 16 }
 };
 
 Image::Image() :
@@ -99,8 +406,8 @@ Image::Image(
 Image::Image(const Image& rhs) :
     super(rhs)
 {
-    allocate(rhs.pixelFormat(), rhs.width(), rhs.height(), rhs.depth());
-    memcpy(_data, rhs._data, sizeInBytes());
+    allocate(rhs.pixelFormat(), rhs.width(), rhs.height(), rhs.depth(), rhs.mipmapLevels());
+    memcpy(_data, rhs._data, sizeInBytesWithMipmaps());
 }
 
 Image::Image(Image&& rhs)
@@ -109,6 +416,7 @@ Image::Image(Image&& rhs)
     _height = rhs._height;
     _depth = rhs._depth;
     _pixelFormat = rhs._pixelFormat;
+    _mipmapLevels = rhs._mipmapLevels;
     _data = rhs.releaseData();
 }
 
@@ -122,7 +430,9 @@ bool
 Image::hasAlphaChannel() const
 {
     return
-        pixelFormat() == R8G8B8A8_UNORM;
+        pixelFormat() == R8G8B8A8_UNORM ||
+        pixelFormat() == BC1_RGBA_UNORM ||
+        pixelFormat() == BC3_UNORM;
 }
 
 shared_ptr<Image>
@@ -133,20 +443,153 @@ Image::clone() const
     auto clone = Image::create(
         pixelFormat(), width(), height(), depth());
 
+    if (mipmapLevels() > 1)
+        clone->allocate(pixelFormat(), width(), height(), depth(), mipmapLevels());
+
     memcpy(
         clone->data<unsigned char*>(),
         _data,
-        sizeInBytes());
+        sizeInBytesWithMipmaps());
 
     return clone;
 }
 
+shared_ptr<Image>
+Image::compress(PixelFormat format) const
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(valid(), nullptr);
+    ROCKY_SOFT_ASSERT_AND_RETURN(format == BC1_RGBA_UNORM || format == BC3_UNORM, nullptr);
+
+    if (pixelFormat() != R8G8B8A8_UNORM && pixelFormat() != R8G8B8_UNORM)
+        return nullptr;
+
+    const bool bc3 = (format == BC3_UNORM);
+    const unsigned bytes_per_block = bc3 ? 16 : 8;
+    const unsigned nc = numComponents();
+
+    // Keep the whole mipmap chain. Levels smaller than a block
+    // still take one whole block each.
+    const unsigned levels = mipmapLevels();
+
+    // VSG finds the compressed mip levels by halving the block counts of the
+    // level above, which agrees with our per-level sizes only when both
+    // dimensions are powers of two.
+    auto pow2 = [](unsigned x) { return (x & (x - 1)) == 0; };
+    if (levels > 1 && (!pow2(width()) || !pow2(height())))
+        return nullptr;
+
+    auto result = Image::create(format, width(), height(), depth());
+    result->allocate(format, width(), height(), depth(), levels);
+
+    bc::block px;
+
+    for (unsigned level = 0; level < levels; ++level)
+    {
+        const unsigned w = std::max(1u, width() >> level);
+        const unsigned h = std::max(1u, height() >> level);
+        const unsigned blocks_x = (w + 3) / 4;
+        const unsigned blocks_y = (h + 3) / 4;
+        auto src = data_at_miplevel(level);
+        auto out = result->data_at_miplevel(level);
+
+        for (unsigned r = 0; r < depth(); ++r)
+        {
+            for (unsigned by = 0; by < blocks_y; ++by)
+            {
+                for (unsigned bx = 0; bx < blocks_x; ++bx)
+                {
+                    // gather the block, repeating edge pixels if the image
+                    // size isn't a multiple of 4:
+                    for (unsigned y = 0; y < 4; ++y)
+                    {
+                        unsigned t = std::min(by * 4 + y, h - 1);
+                        for (unsigned x = 0; x < 4; ++x)
+                        {
+                            unsigned s = std::min(bx * 4 + x, w - 1);
+                            auto p = src + ((r * h + t) * w + s) * nc;
+                            auto& q = px[y * 4 + x];
+                            q[0] = p[0], q[1] = p[1], q[2] = p[2];
+                            q[3] = nc == 4 ? p[3] : 255;
+                        }
+                    }
+
+                    if (bc3)
+                    {
+                        bc::encodeAlpha(px, out);
+                        bc::encodeColor(px, false, out + 8);
+                    }
+                    else
+                    {
+                        bc::encodeColor(px, true, out);
+                    }
+
+                    out += bytes_per_block;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+shared_ptr<Image>
+Image::generateMipmaps() const
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(valid(), nullptr);
+
+    if (compressed() || depth() > 1)
+        return nullptr;
+
+    unsigned levels = 1;
+    while ((std::max(width(), height()) >> levels) > 0)
+        ++levels;
+
+    if (levels == mipmapLevels())
+        return clone();
+
+    // copy the base level into a new image with room for the full chain:
+    auto result = Image::create(pixelFormat(), width(), height(), depth());
+    result->allocate(pixelFormat(), width(), height(), depth(), levels);
+    memcpy(result->_data, _data, sizeInBytes());
+
+    for (unsigned level = 1; level < levels; ++level)
+    {
+        mip::downsample(
+            pixelFormat(),
+            result->data_at_miplevel(level - 1),
+            std::max(1u, width() >> (level - 1)),
+            std::max(1u, height() >> (level - 1)),
+            result->data_at_miplevel(level),
+            std::max(1u, width() >> level),
+            std::max(1u, height() >> level),
+            numComponents());
+    }
+
+    return result;
+}
+
+void
+Image::readCompressed(Pixel& pixel, unsigned s, unsigned t, unsigned r) const
+{
+    auto& layout = _layouts[pixelFormat()];
+    unsigned blocks_x = (width() + 3) / 4;
+    unsigned blocks_y = (height() + 3) / 4;
+    unsigned block = (r * blocks_y + t / 4) * blocks_x + s / 4;
+
+    bc::decode(
+        _data + block * layout.bytes_per_block,
+        pixelFormat() == BC3_UNORM,
+        (t % 4) * 4 + (s % 4),
+        pixel);
+}
+
 void
 Image::allocate(
     PixelFormat pixelFormat_,
     unsigned width_,
     unsigned height_,
-    unsigned depth_)
+    unsigned depth_,
+    unsigned mipmapLevels_)
 {
     ROCKY_SOFT_ASSERT_AND_RETURN(
         width_ > 0 && height_ > 0 && depth_ > 0 &&
@@ -157,13 +600,14 @@ Image::allocate(
     _height = height_;
     _depth = depth_;
     _pixelFormat = pixelFormat_;
+    _mipmapLevels = std::max(1u, mipmapLevels_);
 
     auto layout = _layouts[pixelFormat()];
 
     if (_data)
         delete[] _data;
 
-    _data = new unsigned char[sizeInBytes()];
+    _data = new unsigned char[sizeInBytesWithMipmaps()];
 
     // simple init for one-byte images
     if (sizeInBytes() > 0)
@@ -178,6 +622,7 @@ Image::releaseData()
     _width = 0;
     _height = 0;
     _depth = 0;
+    _mipmapLevels = 1;
     return released;
 }
 
@@ -214,22 +659,28 @@ Image::copyAsSubImage(
 void
 Image::flipVerticalInPlace()
 {
-    ROCKY_TODO("handle compressed pixel formats");
-
-    auto layerBytes = sizeInBytes() / depth();
-    auto rowBytes = rowSizeInBytes();
-    auto halfRows = height() / 2;
+    // flipping a row of blocks would not flip the rows within each block
+    ROCKY_SOFT_ASSERT_AND_RETURN(!compressed(), void());
 
-    for (unsigned d = 0; d < depth(); ++d)
+    for (unsigned level = 0; level < mipmapLevels(); ++level)
     {
-        unsigned layerOffset = d * layerBytes;
-        for (unsigned row = 0; row < halfRows; ++row)
+        auto levelData = data_at_miplevel(level);
+        auto layerBytes = sizeof_miplevel(level) / depth();
+        auto rows = std::max(1u, height() >> level);
+        auto rowBytes = layerBytes / rows;
+        auto halfRows = rows / 2;
+
+        for (unsigned d = 0; d < depth(); ++d)
         {
-            auto antirow = height() - 1 - row;
-            auto row1 = data<uchar>() + layerOffset + row*rowBytes;
-            auto row2 = data<uchar>() + layerOffset + antirow*rowBytes;
-            for (unsigned b = 0; b < rowBytes; ++b, ++row1, ++row2)
-                std::swap(*row1, *row2);
+            unsigned layerOffset = d * layerBytes;
+            for (unsigned row = 0; row < halfRows; ++row)
+            {
+                auto antirow = rows - 1 - row;
+                auto row1 = levelData + layerOffset + row*rowBytes;
+                auto row2 = levelData + layerOffset + antirow*rowBytes;
+                for (unsigned b = 0; b < rowBytes; ++b, ++row1, ++row2)
+                    std::swap(*row1, *row2);
+            }
         }
     }
 }
@@ -37,6 +37,8 @@ namespace ROCKY_NAMESPACE
             R16_UNORM,
             R32_SFLOAT,
             R64_SFLOAT,
+            BC1_RGBA_UNORM, // block-compressed RGB with 1-bit alpha, 4 bits per pixel
+            BC3_UNORM,      // block-compressed RGBA, 8 bits per pixel
             NUM_PIXEL_FORMATS,
             UNDEFINED
         };
@@ -59,6 +61,16 @@ namespace ROCKY_NAMESPACE
         //! Whether there's an alpha channel
         bool hasAlphaChannel() const;
 
+        //! Whether the pixel format is block-compressed. You can read()
+        //! the pixels of a compressed image, but you cannot write() them.
+        inline bool compressed() const;
+
+        //! Width and height of a compression block in pixels (1 if uncompressed)
+        inline unsigned blockSize() const;
+
+        //! Number of mipmap levels stored in the image, including the base level
+        inline unsigned mipmapLevels() const { return _mipmapLevels; }
+
     public:
         //! Construct an empty (invalid) image
         Image();
@@ -129,9 +141,12 @@ namespace ROCKY_NAMESPACE
             unsigned t,
             unsigned layer = 0);
 
-        //! Size of this image in bytes
+        //! Size of this image in bytes (the base level only)
         inline unsigned sizeInBytes() const;
 
+        //! Size of this image in bytes, including all mipmap levels
+        inline unsigned sizeInBytesWithMipmaps() const;
+
         //! Size of this image in pixels
         inline unsigned sizeInPixels() const;
 
@@ -144,6 +159,21 @@ namespace ROCKY_NAMESPACE
         //! Creates a deep copy of this image
         shared_ptr<Image> clone() const;
 
+        //! Creates a block-compressed copy of this 8-bit RGB or RGBA image,
+        //! which takes 4-8x less GPU memory and upload bandwidth.
+        //! @param format BC1_RGBA_UNORM or BC3_UNORM
+        //! A mipmapped image must have power-of-two dimensions.
+        //! @return Compressed image, or nullptr if this image can't be compressed
+        shared_ptr<Image> compress(PixelFormat format) const;
+
+        //! Creates a copy of this image with a full chain of mipmaps, down to 1x1,
+        //! box-filtering each level from the one above. The levels are stored after
+        //! the base level in the data array, where GPU uploads expect to find them.
+        //! Read and write only ever access the base level.
+        //! Not supported for compressed or 3D images.
+        //! @return Mipmapped image, or nullptr if this image can't be mipmapped
+        shared_ptr<Image> generateMipmaps() const;
+
         //! Creates a cropped copy of this image
         shared_ptr<Image> crop(
             double src_minx, double src_miny,
@@ -204,24 +234,30 @@ namespace ROCKY_NAMESPACE
         unsigned _width, _height, _depth;
         PixelFormat _pixelFormat;
         unsigned char* _data;
+        unsigned _mipmapLevels = 1;
 
         void allocate(
             PixelFormat format,
             unsigned s,
             unsigned t,
-            unsigned r);
+            unsigned r,
+            unsigned mipmapLevels = 1);
 
         struct Layout {
             void(*read)(Pixel&, unsigned char*, int);
             void(*write)(const Pixel&, unsigned char*, int);
             int num_components;
-            int bytes_per_pixel;
+            int bytes_per_pixel; // 0 for compressed formats
             PixelFormat format;
+            int block_size; // width and height of a block, in pixels
+            int bytes_per_block;
         };
-        static Layout _layouts[7];
+        static Layout _layouts[NUM_PIXEL_FORMATS];
+
+        void readCompressed(Pixel& pixel, unsigned s, unsigned t, unsigned layer) const;
 
         inline unsigned sizeof_miplevel(unsigned level) const;
-        inline unsigned char* data_at_miplevel(unsigned level);
+        inline unsigned char* data_at_miplevel(unsigned level) const;
     };
 
 
@@ -232,8 +268,24 @@ namespace ROCKY_NAMESPACE
         return width() > 0 && height() > 0 && depth() > 0 && _data;
     }
 
+    bool Image::compressed() const
+    {
+        return _layouts[pixelFormat()].block_size > 1;
+    }
+
+    unsigned Image::blockSize() const
+    {
+        return _layouts[pixelFormat()].block_size;
+    }
+
     void Image::read(Pixel& pixel, unsigned s, unsigned t, unsigned r) const
     {
+        if (compressed())
+        {
+            readCompressed(pixel, s, t, r);
+            return;
+        }
+
         _layouts[pixelFormat()].read(
             pixel,
             _data + (width()*height()*r + width()*t + s)*_layouts[pixelFormat()].bytes_per_pixel,
@@ -272,13 +324,13 @@ namespace ROCKY_NAMESPACE
     {
         _layouts[pixelFormat()].write(
             pixel,
-            _data + (width()*height()*r + height() * t + s)*_layouts[pixelFormat()].bytes_per_pixel,
+            _data + (width()*height()*r + width()*t + s)*_layouts[pixelFormat()].bytes_per_pixel,
             _layouts[pixelFormat()].num_components);
     }
 
     unsigned Image::sizeInBytes() const
     {
-        return sizeInPixels() * _layouts[pixelFormat()].bytes_per_pixel;
+        return rowSizeInBytes() * ((height() + blockSize() - 1) / blockSize()) * depth();
     }
 
     unsigned Image::sizeInPixels() const
@@ -288,10 +340,20 @@ namespace ROCKY_NAMESPACE
 
     unsigned Image::rowSizeInBytes() const
     {
-        return width() * _layouts[pixelFormat()].bytes_per_pixel;
+        // for a compressed image, a "row" is a row of blocks
+        auto& layout = _layouts[pixelFormat()];
+        return ((width() + layout.block_size - 1) / layout.block_size) * layout.bytes_per_block;
+    }
+
+    unsigned Image::sizeInBytesWithMipmaps() const
+    {
+        unsigned total = 0;
+        for (unsigned i = 0; i < mipmapLevels(); ++i)
+            total += sizeof_miplevel(i);
+        return total;
     }
 
-    unsigned char* Image::data_at_miplevel(unsigned m)
+    unsigned char* Image::data_at_miplevel(unsigned m) const
     {
         auto d = _data;
         for (int i = 0; i < (int)m; ++i)
@@ -301,7 +363,14 @@ namespace ROCKY_NAMESPACE
 
     unsigned Image::sizeof_miplevel(unsigned level) const
     {
-        return (width() * height() * depth()) >> level;
+        // Each level halves the size in pixels, which a compressed level then
+        // rounds up to whole blocks (blocks are just pixels if the image isn't
+        // compressed). This matches how Vulkan lays out compressed mip levels.
+        auto& layout = _layouts[pixelFormat()];
+        unsigned b = layout.block_size;
+        unsigned blocks_x = (std::max(1u, width() >> level) + b - 1) / b;
+        unsigned blocks_y = (std::max(1u, height() >> level) + b - 1) / b;
+        return blocks_x * blocks_y * depth() * layout.bytes_per_block;
     }
 
     unsigned Image::numComponents() const
@@ -311,7 +380,8 @@ namespace ROCKY_NAMESPACE
 
     unsigned Image::componentSizeInBytes() const
     {
-        return _layouts[pixelFormat()].bytes_per_pixel /
+        return compressed() ? 0 :
+            _layouts[pixelFormat()].bytes_per_pixel /
             _layouts[pixelFormat()].num_components;
     }
 
@@ -124,36 +124,61 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, const IOOptions& io) con
         return Result(GeoImage::INVALID);
     }
 
-    // Tile gate prevents two threads from requesting the same key
-    // at the same time, which would be unnecessary work. Only lock
-    // the gate if there is an L2 cache active
-    ROCKY_TODO("Sentry");
-    //util::ScopedGate<TileKey> scopedGate(_sentry, key, [&]() {
-    //    return _memCache.valid();
-    //});
-
-    Result<GeoImage> result;
-
-    // if this layer has no profile, just go straight to the driver.
-    if (!profile().valid())
-    {
-        std::shared_lock lock(layerStateMutex());
-        return createImageImplementation(key, io);
-    }
+    // Only one thread creates any given key at a time; others asking for
+    // the same key (e.g. many tiles falling back on the same parent) wait
+    // for and share its result.
+    return _inflight.run(key, [&]() -> Result<GeoImage>
+        {
+            Result<GeoImage> result;
 
-    else if (key.profile() == profile())
-    {
-        std::shared_lock lock(layerStateMutex());
-        result = createImageImplementation(key, io);
-    }
-    else
-    {
-        // If the profiles are different, use a compositing method to assemble the tile.
-        auto image = assembleImage(key, io);
-        result = GeoImage(image, key.extent());
-    }
+            // if this layer has no profile, just go straight to the driver.
+            if (!profile().valid())
+            {
+                std::shared_lock lock(layerStateMutex());
+                return createImageImplementation(key, io);
+            }
 
-    return result;
+            // Check the cache. An expired record is held in reserve in case
+            // the source is unavailable.
+            bool expired = false;
+            auto cached = readRasterFromCache(key, io, expired);
+            if (cached.status.ok() && !expired)
+            {
+                return GeoImage(cached.value, key.extent());
+            }
+
+            if (isCacheOnly())
+            {
+                if (cached.status.ok())
+                    return GeoImage(cached.value, key.extent());
+                else
+                    return Result(GeoImage::INVALID);
+            }
+
+            if (key.profile() == profile())
+            {
+                std::shared_lock lock(layerStateMutex());
+                result = createImageImplementation(key, io);
+            }
+            else
+            {
+                // If the profiles are different, use a compositing method to assemble the tile.
+                auto image = assembleImage(key, io);
+                result = GeoImage(image, key.extent());
+            }
+
+            if (result.status.ok() && result.value.valid())
+            {
+                writeRasterToCache(key, *result.value.image(), io);
+            }
+            else if (cached.status.ok())
+            {
+                // source failed; fall back on the expired cache record.
+                result = GeoImage(cached.value, key.extent());
+            }
+
+            return result;
+        }, &io);
 }
 
 shared_ptr<Image>
@@ -9,6 +9,7 @@
 #include <rocky/TileLayer.h>
 #include <rocky/GeoImage.h>
 #include <rocky/Color.h>
+#include <rocky/Threading.h>
 
 namespace ROCKY_NAMESPACE
 {
@@ -119,6 +120,9 @@ namespace ROCKY_NAMESPACE
             const TileKey& key,
             const IOOptions& io) const;
 
+        // Shares the result among concurrent requests for the same key
+        mutable util::Coalescer<TileKey, Result<GeoImage>> _inflight;
+
         // Fetches multiple images from the TileSource; mosaics/reprojects/crops as necessary, and
         // returns a single tile. This is called by createImageFromTileSource() if the key profile
         // doesn't match the layer profile.
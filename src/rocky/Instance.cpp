@@ -4,6 +4,7 @@
  * MIT License
  */
 #include "Instance.h"
+#include "DiskCache.h"
 #include "Profile.h"
 #include "SRS.h"
 #include "Threading.h"
@@ -18,6 +19,7 @@ ROCKY_ABOUT(glm, std::to_string(GLM_VERSION_MAJOR) + "." + std::to_string(GLM_VE
 ROCKY_ABOUT(nlohmann_json, std::to_string(NLOHMANN_JSON_VERSION_MAJOR) + "." + std::to_string(NLOHMANN_JSON_VERSION_MINOR));
 
 #ifdef ROCKY_HAS_GDAL
+#include "GDAL.h"
 #include <gdal.h>
 #include <cpl_conv.h>
 ROCKY_ABOUT(gdal, GDAL_RELEASE_NAME)
@@ -53,6 +55,21 @@ namespace
     {
         Log()->info("GDAL says: " + std::string(msg) + std::string(" (error ") + std::to_string(errNum) + ")");
     }
+
+    // map of mime-types to the GDAL drivers that can decode/encode them
+    std::string gdal_driver_for_mime_type(const std::string& contentType)
+    {
+        static const std::unordered_map<std::string, std::string> drivers = {
+            { "image/jpg", "JPEG" },
+            { "image/jpeg", "JPEG" },
+            { "image/png", "PNG" },
+            { "image/tif", "GTiff" },
+            { "image/tiff", "GTiff" },
+            { "image/webp", "WEBP" }
+        };
+        auto i = drivers.find(contentType);
+        return i != drivers.end() ? i->second : std::string();
+    }
 }
 #endif
 
@@ -92,8 +109,42 @@ Instance::Instance()
     // available memory which is too high.
     GDALSetCacheMax(40 * 1024 * 1024);
 
+    // Image codecs. Subclasses like InstanceVSG may replace these with their own.
+    _impl->ioOptions.services.readImageFromStream = [](
+        std::istream& in, std::string contentType, const IOOptions& io) -> Result<shared_ptr<Image>>
+    {
+        // an empty driver name lets GDAL identify the format itself
+        auto driver = gdal_driver_for_mime_type(contentType);
+        if (!contentType.empty() && driver.empty())
+            return Status(Status::ServiceUnavailable, "No image reader for \"" + contentType + "\"");
+
+        std::stringstream buf;
+        buf << in.rdbuf();
+        std::string data = buf.str();
+        return GDAL::readImage((unsigned char*)data.data(), (unsigned)data.length(), driver);
+    };
+
+    _impl->ioOptions.services.writeImageToStream = [](
+        shared_ptr<Image> image, std::ostream& out, std::string contentType, const IOOptions& io) -> Status
+    {
+        auto driver = gdal_driver_for_mime_type(contentType);
+        if (driver.empty())
+            return Status(Status::ServiceUnavailable, "No image writer for \"" + contentType + "\"");
+
+        return GDAL::writeImage(image, out, driver);
+    };
+
 #endif // ROCKY_HAS_GDAL
 
+    // Set up a persistent disk cache if the user requested one
+    const char* cache_path = ::getenv("ROCKY_CACHE_PATH");
+    if (cache_path)
+    {
+        auto cache = DiskCache::create(std::string(cache_path));
+        _impl->ioOptions.services.cache = [cache]() { return cache; };
+        Log()->info("Using disk cache at " + cache->rootPath());
+    }
+
     // Check for some environment variables that are important to rocky apps
     //if (::getenv("PROJ_DATA") == nullptr)
     //{
@@ -5,69 +5,255 @@
  */
 #pragma once
 #include <rocky/Common.h>
+#include <rocky/Metrics.h>
 #include <mutex>
 #include <unordered_map>
 #include <list>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
 #include <algorithm>
+#include <cstdint>
 
 namespace ROCKY_NAMESPACE
 {
     namespace util
     {
-        // Adapted from https://www.geeksforgeeks.org/lru-cache-implementation
+        /**
+        * Thread-safe least-recently-used cache.
+        *
+        * The cache is split into shards, each with its own lock and its own
+        * share of the capacity, so that threads working on different keys
+        * rarely contend. Eviction is LRU within each shard.
+        *
+        * Capacity is measured in whatever units the "sizer" function returns
+        * for each value; by default every value counts as 1, making the
+        * capacity a number of entries. Supply a sizer that returns a byte
+        * count to budget the cache by memory instead.
+        *
+        * A value larger than one shard's share of the capacity (capacity
+        * divided by the number of shards) is never cached; put() drops it and
+        * counts it in metrics().rejections.
+        *
+        * Set plotNames to also plot the hit, miss and eviction counts with the
+        * profiler (see util::Metrics) as they change.
+        */
         template<class K, class V>
         class LRUCache
         {
-        private:
-            mutable std::mutex mutex;
-            int capacity;
-            using E = typename std::pair<K, V>;
-            typename std::list<E> cache;
-            std::unordered_map<K, typename std::list<E>::iterator> map;
-
         public:
-            int hits = 0;
-            int gets = 0;
+            //! Returns the size of a value, in capacity units
+            using Sizer = std::function<std::size_t(const V&)>;
+
+            //! Usage statistics
+            struct Metrics
+            {
+                std::uint64_t gets = 0;
+                std::uint64_t hits = 0;
+                std::uint64_t evictions = 0;
+                std::uint64_t rejections = 0;
+                std::size_t entries = 0;
+                std::size_t size = 0; // in capacity units
+                std::size_t capacity = 0; // in capacity units
+            };
 
-            LRUCache(int capacity_ = 32) : capacity(capacity_) { }
+            //! Number of calls to get()
+            std::atomic<std::uint64_t> gets = { 0 };
 
-            inline void setCapacity(int value)
+            //! Number of calls to get() that found their key
+            std::atomic<std::uint64_t> hits = { 0 };
+
+            //! Number of entries evicted to make room for new ones
+            std::atomic<std::uint64_t> evictions = { 0 };
+
+            //! Number of values put() dropped for being larger than a shard
+            std::atomic<std::uint64_t> rejections = { 0 };
+
+            //! Profiler plot names for the counters; nullptr = don't plot.
+            //! The profiler keeps the pointers, so use string literals.
+            struct PlotNames
             {
-                std::scoped_lock L(mutex);
-                cache.clear();
-                map.clear();
-                hits = 0;
+                const char* hits = nullptr;
+                const char* misses = nullptr;
+                const char* evictions = nullptr;
+            };
+            PlotNames plotNames;
+
+            //! Construct a cache
+            //! @param capacity Total capacity, in sizer units (entries by default)
+            //! @param num_shards Number of independently locked shards
+            //! @param sizer Function returning the size of a value (default = 1)
+            LRUCache(std::size_t capacity = 32, unsigned num_shards = 1, Sizer sizer = {}) :
+                _sizer(sizer),
+                _shards(std::max(1u, num_shards))
+            {
+                setCapacity(capacity);
+            }
+
+            //! Total capacity, in sizer units
+            inline std::size_t capacity() const
+            {
+                return _capacity;
+            }
+
+            //! Clears the cache and sets a new total capacity
+            inline void setCapacity(std::size_t value)
+            {
+                _capacity = value;
+
+                // each shard gets an equal share of the total
+                std::size_t per_shard = value == 0 ? 0 : std::max(
+                    (std::size_t)1, value / _shards.size());
+
+                for (auto& shard : _shards)
+                {
+                    std::scoped_lock L(shard.mutex);
+                    shard.cache.clear();
+                    shard.map.clear();
+                    shard.size = 0;
+                    shard.capacity = per_shard;
+                }
+
                 gets = 0;
-                capacity = std::max(0, value);
+                hits = 0;
+                evictions = 0;
+                rejections = 0;
             }
 
+            //! Gets the value associated with a key, or a default value if
+            //! the key is not in the cache.
             inline V get(const K& key)
             {
-                if (capacity == 0)
+                if (_capacity == 0)
                     return V();
-                std::scoped_lock L(mutex);
+
                 ++gets;
-                auto it = map.find(key);
-                if (it == map.end())
+
+                auto& shard = shardFor(key);
+                std::scoped_lock L(shard.mutex);
+                auto it = shard.map.find(key);
+                if (it == shard.map.end())
+                {
+                    if (plotNames.misses)
+                    {
+                        ROCKY_PROFILING_PLOT(plotNames.misses, (std::int64_t)(gets - hits));
+                    }
                     return V();
-                cache.splice(cache.end(), cache, it->second);
+                }
+
+                shard.cache.splice(shard.cache.end(), shard.cache, it->second);
                 ++hits;
-                return it->second->second;
+
+                if (plotNames.hits)
+                {
+                    ROCKY_PROFILING_PLOT(plotNames.hits, (std::int64_t)hits.load());
+                }
+                return it->second->value;
             }
 
+            //! Adds a value to the cache (or replaces the existing one),
+            //! evicting the least recently used values if necessary.
+            //! A value bigger than a shard's capacity is not cached.
             inline void put(const K& key, const V& value)
             {
-                if (capacity == 0)
+                if (_capacity == 0)
                     return;
-                std::scoped_lock L(mutex);
-                if (cache.size() == capacity)
+
+                std::size_t size = _sizer ? _sizer(value) : 1;
+
+                auto& shard = shardFor(key);
+                std::scoped_lock L(shard.mutex);
+
+                auto it = shard.map.find(key);
+                if (it != shard.map.end())
+                {
+                    shard.size -= it->second->size;
+                    shard.cache.erase(it->second);
+                    shard.map.erase(it);
+                }
+
+                // don't flush the whole shard for a value that won't fit anyway
+                if (size > shard.capacity)
+                {
+                    ++rejections;
+                    return;
+                }
+
+                while (!shard.cache.empty() && shard.size + size > shard.capacity)
+                {
+                    auto& lru = shard.cache.front();
+                    shard.size -= lru.size;
+                    shard.map.erase(lru.key);
+                    shard.cache.pop_front();
+                    ++evictions;
+
+                    if (plotNames.evictions)
+                    {
+                        ROCKY_PROFILING_PLOT(plotNames.evictions, (std::int64_t)evictions.load());
+                    }
+                }
+
+                shard.cache.push_back(Entry{ key, value, size });
+                shard.map[key] = std::prev(shard.cache.end());
+                shard.size += size;
+            }
+
+            //! Removes everything from the cache
+            inline void clear()
+            {
+                for (auto& shard : _shards)
+                {
+                    std::scoped_lock L(shard.mutex);
+                    shard.cache.clear();
+                    shard.map.clear();
+                    shard.size = 0;
+                }
+            }
+
+            //! Current usage statistics
+            inline Metrics metrics() const
+            {
+                Metrics m;
+                m.gets = gets;
+                m.hits = hits;
+                m.evictions = evictions;
+                m.rejections = rejections;
+                m.capacity = _capacity;
+                for (auto& shard : _shards)
                 {
-                    auto first_key = cache.front().first;
-                    cache.pop_front();
-                    map.erase(first_key);
+                    std::scoped_lock L(shard.mutex);
+                    m.entries += shard.map.size();
+                    m.size += shard.size;
                 }
-                cache.emplace_back(key, value);
-                map[key] = --cache.end();
+                return m;
+            }
+
+        private:
+            struct Entry
+            {
+                K key;
+                V value;
+                std::size_t size;
+            };
+
+            struct Shard
+            {
+                mutable std::mutex mutex;
+                std::list<Entry> cache;
+                std::unordered_map<K, typename std::list<Entry>::iterator> map;
+                std::size_t size = 0;
+                std::size_t capacity = 0;
+            };
+
+            Sizer _sizer;
+            std::vector<Shard> _shards;
+            std::atomic<std::size_t> _capacity = { 0 };
+
+            inline Shard& shardFor(const K& key)
+            {
+                return _shards.size() == 1 ? _shards.front() :
+                    _shards[std::hash<K>()(key) % _shards.size()];
             }
         };
     }
@@ -37,6 +37,7 @@ Layer::construct(const JSON& conf)
     get_to(j, "name", _name);
     get_to(j, "open", _openAutomatically);
     get_to(j, "attribution", _attribution);
+    get_to(j, "cache_id", _cacheid);
     get_to(j, "l2_cache_size", _l2cachesize);
 
     _status = Status(
@@ -52,6 +53,7 @@ Layer::to_json() const
     set(j, "name", _name);
     set(j, "open", _openAutomatically);
     set(j, "attribution", _attribution);
+    set(j, "cache_id", _cacheid);
     set(j, "l2_cache_size", _l2cachesize);
     return j.dump();
 }
@@ -9,6 +9,7 @@
 #include "Image.h"
 #include "json.h"
 #include "Instance.h"
+#include "Threading.h"
 #include <filesystem>
 
 #include <sqlite3.h>
@@ -19,6 +20,19 @@ using namespace ROCKY_NAMESPACE;
 #undef LC
 #define LC "[MBTiles] "
 
+struct MBTiles::Driver::Reader
+{
+    sqlite3* database = nullptr;
+    sqlite3_stmt* select = nullptr;
+
+    ~Reader()
+    {
+        if (select)
+            sqlite3_finalize(select);
+        if (database)
+            sqlite3_close_v2(database);
+    }
+};
 
 
 MBTiles::Driver::Driver() :
@@ -38,6 +52,21 @@ MBTiles::Driver::~Driver()
 void
 MBTiles::Driver::close()
 {
+    stopWriter();
+
+    if (_insert)
+    {
+        sqlite3_finalize((sqlite3_stmt*)_insert);
+        _insert = nullptr;
+    }
+
+    {
+        std::scoped_lock lock(_readersMutex);
+        for (auto reader : _readers)
+            delete reader;
+        _readers.clear();
+    }
+
     if (_database != nullptr)
     {
         sqlite3* database = (sqlite3*)_database;
@@ -56,8 +85,10 @@ MBTiles::Driver::open(
     const IOOptions& io)
 {
     _name = name;
+    _options = options;
 
     std::string fullFilename = options.uri->full();
+    _filename = fullFilename;
 
     bool readWrite = isWritingRequested;
 
@@ -99,6 +130,13 @@ MBTiles::Driver::open(
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(database));
     }
 
+    if (readWrite)
+    {
+        // Write-ahead logging lets the read connections keep reading
+        // while we write.
+        sqlite3_exec((sqlite3*)_database, "PRAGMA journal_mode=WAL", 0L, 0L, 0L);
+    }
+
     // New database setup:
     if (isNewDatabase)
     {
@@ -287,11 +325,63 @@ MBTiles::Driver::readMaxLevel()
     return result;
 }
 
+MBTiles::Driver::Reader*
+MBTiles::Driver::acquireReader() const
+{
+    {
+        std::scoped_lock lock(_readersMutex);
+        if (!_readers.empty())
+        {
+            auto reader = _readers.back();
+            _readers.pop_back();
+            return reader;
+        }
+    }
+
+    // none available; open a new connection. NOMUTEX is safe because
+    // only one thread at a time uses a reader.
+    auto reader = new Reader();
+
+    int rc = sqlite3_open_v2(_filename.c_str(), &reader->database,
+        SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L);
+
+    if (rc != SQLITE_OK)
+    {
+        Log()->warn(LC "Failed to open \"" + _filename + "\" for reading: " + sqlite3_errstr(rc));
+        delete reader;
+        return nullptr;
+    }
+
+    // wait out a concurrent writer instead of failing, and memory-map
+    // the file to avoid copying pages through the sqlite page cache
+    sqlite3_busy_timeout(reader->database, 5000);
+    sqlite3_exec(reader->database, "PRAGMA mmap_size=268435456", 0L, 0L, 0L);
+
+    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+    rc = sqlite3_prepare_v2(reader->database, query.c_str(), -1, &reader->select, 0L);
+    if (rc != SQLITE_OK)
+    {
+        Log()->warn(LC "Failed to prepare SQL: " + query + "; " + sqlite3_errmsg(reader->database));
+        delete reader;
+        return nullptr;
+    }
+
+    return reader;
+}
+
+void
+MBTiles::Driver::releaseReader(Reader* reader) const
+{
+    sqlite3_reset(reader->select);
+    sqlite3_clear_bindings(reader->select);
+
+    std::scoped_lock lock(_readersMutex);
+    _readers.push_back(reader);
+}
+
 Result<shared_ptr<Image>>
 MBTiles::Driver::read(const TileKey& key, const IOOptions& io) const
 {
-    std::scoped_lock lock(_mutex);
-
     int z = key.levelOfDetail();
     int x = key.tileX();
     int y = key.tileY();
@@ -310,18 +400,14 @@ MBTiles::Driver::read(const TileKey& key, const IOOptions& io) const
     auto [numCols, numRows] = key.profile().numTiles(key.levelOfDetail());
     y = numRows - y - 1;
 
-    sqlite3* database = (sqlite3*)_database;
-
-    //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2(database, query.c_str(), -1, &select, 0L);
-    if (rc != SQLITE_OK)
+    auto reader = acquireReader();
+    if (!reader)
     {
-        return Status(Status::GeneralError, util::make_string()
-            << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database));
+        return Status(Status::ResourceUnavailable, "Cannot read from database " + _filename);
     }
 
+    auto select = reader->select;
+
     bool valid = true;
 
     sqlite3_bind_int(select, 1, z);
@@ -331,7 +417,7 @@ MBTiles::Driver::read(const TileKey& key, const IOOptions& io) const
     Result<shared_ptr<Image>> result;
     std::string errorMessage;
 
-    rc = sqlite3_step(select);
+    int rc = sqlite3_step(select);
     if (rc == SQLITE_ROW)
     {
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
@@ -340,6 +426,10 @@ MBTiles::Driver::read(const TileKey& key, const IOOptions& io) const
 
         std::string dataBuffer(data, dataLen);
 
+        // done with the connection; decode without holding it.
+        releaseReader(reader);
+        reader = nullptr;
+
 #ifdef ROCKY_HAS_ZLIB
         // decompress if necessary:
         if (_options.compress == true)
@@ -367,7 +457,10 @@ MBTiles::Driver::read(const TileKey& key, const IOOptions& io) const
         }
     }
 
-    sqlite3_finalize(select);
+    if (reader)
+    {
+        releaseReader(reader);
+    }
 
     if (!valid)
     {
@@ -387,7 +480,8 @@ MBTiles::Driver::write(const TileKey& key, shared_ptr<Image> input, const IOOpti
     if (!io.services.writeImageToStream)
         return Status(Status::ServiceUnavailable);
 
-    std::scoped_lock lock(_mutex);
+    if (_database == nullptr)
+        return Status(Status::ResourceUnavailable);
 
     // encode the data stream:
     std::stringstream buf;
@@ -436,56 +530,146 @@ MBTiles::Driver::write(const TileKey& key, shared_ptr<Image> input, const IOOpti
     auto [numCols, numRows] = key.profile().numTiles(key.levelOfDetail());
     y = numRows - y - 1;
 
-    sqlite3* database = (sqlite3*)_database;
+    // queue it up for the writer thread:
+    {
+        std::unique_lock<std::mutex> lock(_writeQueueMutex);
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2(database, query.c_str(), -1, &insert, 0L);
-    if (rc != SQLITE_OK)
+        _writeQueue.push_back(PendingTile{ z, x, y, std::move(value) });
+
+        if (!_writer.joinable())
+        {
+            _writerDone = false;
+            _writer = std::thread([this]()
+                {
+                    util::setThreadName("rocky::mbtiles");
+
+                    std::unique_lock<std::mutex> lock(_writeQueueMutex);
+                    while (!_writerDone)
+                    {
+                        // wait for a full batch, or for the interval to elapse
+                        _writeQueueCV.wait_for(lock, std::chrono::milliseconds(_options.writeBatchInterval.value()), [this]() {
+                            return _writerDone || _writeQueue.size() >= _options.writeBatchSize.value(); });
+
+                        if (!_writeQueue.empty())
+                        {
+                            lock.unlock();
+                            commitWriteQueue();
+                            lock.lock();
+                        }
+                    }
+                });
+        }
+        else if (_writeQueue.size() >= _options.writeBatchSize.value())
+        {
+            _writeQueueCV.notify_one();
+        }
+    }
+
+    // adjust the level range if necessary
+    unsigned lod = key.levelOfDetail();
+    for (unsigned v = _maxLevel; lod > v && !_maxLevel.compare_exchange_weak(v, lod); );
+    for (unsigned v = _minLevel; lod < v && !_minLevel.compare_exchange_weak(v, lod); );
+
+    return StatusOK;
+}
+
+void
+MBTiles::Driver::commitWriteQueue() const
+{
+    // hold the database lock while taking the batch, so batches
+    // commit in the order they were queued
+    std::scoped_lock lock(_mutex);
+
+    std::vector<PendingTile> batch;
     {
-        return Status(Status::GeneralError, util::make_string()
-            << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database));
+        std::scoped_lock lock(_writeQueueMutex);
+        batch.swap(_writeQueue);
     }
 
-    // bind parameters:
-    sqlite3_bind_int(insert, 1, z);
-    sqlite3_bind_int(insert, 2, x);
-    sqlite3_bind_int(insert, 3, y);
+    if (batch.empty() || _database == nullptr)
+        return;
 
-    // bind the data blob:
-    sqlite3_bind_blob(insert, 4, value.c_str(), value.length(), SQLITE_STATIC);
+    sqlite3* database = (sqlite3*)_database;
+
+    // Prep the insert statement once and reuse it:
+    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+    sqlite3_stmt* insert = (sqlite3_stmt*)_insert;
+    if (insert == nullptr)
+    {
+        int rc = sqlite3_prepare_v2(database, query.c_str(), -1, &insert, 0L);
+        if (rc != SQLITE_OK)
+        {
+            Log()->warn(LC "Failed to prepare SQL: " + query + "; " + sqlite3_errmsg(database));
+            return;
+        }
+        _insert = insert;
+    }
 
-    // run the sql.
-    bool ok = true;
-    int tries = 0;
-    do {
-        rc = sqlite3_step(insert);
-    } while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
+    // one transaction for the whole batch:
+    sqlite3_exec(database, "BEGIN TRANSACTION", 0L, 0L, 0L);
 
-    if (SQLITE_OK != rc && SQLITE_DONE != rc)
+    unsigned errors = 0;
+    for (auto& tile : batch)
     {
-#if SQLITE_VERSION_NUMBER >= 3007015
-        return Status(Status::GeneralError, util::make_string() << "Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(database));
-#else
-        return Status(Status::GeneralError, make_string() << "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(database));
-#endif
-        ok = false;
+        // bind parameters:
+        sqlite3_bind_int(insert, 1, tile.z);
+        sqlite3_bind_int(insert, 2, tile.x);
+        sqlite3_bind_int(insert, 3, tile.y);
+
+        // bind the data blob:
+        sqlite3_bind_blob(insert, 4, tile.data.c_str(), (int)tile.data.length(), SQLITE_STATIC);
+
+        // run the sql.
+        int rc;
+        int tries = 0;
+        do {
+            rc = sqlite3_step(insert);
+        } while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
+
+        if (SQLITE_OK != rc && SQLITE_DONE != rc)
+        {
+            if (errors++ == 0)
+            {
+                Log()->warn(LC "Failed query: " + query + " (" + std::to_string(rc) + ") " + sqlite3_errmsg(database));
+            }
+        }
+
+        sqlite3_reset(insert);
     }
 
-    sqlite3_finalize(insert);
+    sqlite3_clear_bindings(insert);
 
-    // adjust the max level if necessary
-    if (key.levelOfDetail() > _maxLevel)
+    if (SQLITE_OK != sqlite3_exec(database, "COMMIT TRANSACTION", 0L, 0L, 0L))
     {
-        _maxLevel = key.levelOfDetail();
+        Log()->warn(LC "Failed to commit " + std::to_string(batch.size()) + " tiles to " + _name + "; " + sqlite3_errmsg(database));
+        sqlite3_exec(database, "ROLLBACK TRANSACTION", 0L, 0L, 0L);
     }
-    if (key.levelOfDetail() < _minLevel)
+    else if (errors > 0)
     {
-        _minLevel = key.levelOfDetail();
+        Log()->warn(LC "Failed to write " + std::to_string(errors) + " of " + std::to_string(batch.size()) + " tiles to " + _name);
     }
+}
 
-    return StatusOK;
+void
+MBTiles::Driver::flush() const
+{
+    commitWriteQueue();
+}
+
+void
+MBTiles::Driver::stopWriter()
+{
+    {
+        std::scoped_lock lock(_writeQueueMutex);
+        _writerDone = true;
+    }
+    _writeQueueCV.notify_all();
+
+    if (_writer.joinable())
+        _writer.join();
+
+    // write anything left over
+    commitWriteQueue();
 }
 
 bool
@@ -10,6 +10,11 @@
 #include <rocky/Status.h>
 #include <rocky/URI.h>
 #include <rocky/TileKey.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 
 namespace ROCKY_NAMESPACE
 {
@@ -25,6 +30,13 @@ namespace ROCKY_NAMESPACE
             optional<URI> uri;
             optional<std::string> format = std::string("image/png");
             optional<bool> compress = false;
+
+            //! Maximum number of written tiles to commit in one transaction
+            optional<unsigned> writeBatchSize = 1024u;
+
+            //! Maximum time (milliseconds) a written tile waits for its
+            //! transaction to commit
+            optional<unsigned> writeBatchInterval = 250u;
         };
 
         /**
@@ -50,28 +62,62 @@ namespace ROCKY_NAMESPACE
                 const TileKey& key,
                 const IOOptions& io) const;
 
+            //! Queues a tile for writing. Tiles are written in batches, one
+            //! transaction per batch, in a background thread; call flush()
+            //! to commit everything written so far.
             Status write(
                 const TileKey& key,
                 shared_ptr<Image> image,
                 const IOOptions& io) const;
 
+            //! Commits all queued tiles to the database.
+            void flush() const;
+
             void setDataExtents(const DataExtentList&);
             bool getMetaData(const std::string& name, std::string& value);
             bool putMetaData(const std::string& name, const std::string& value);
 
         private:
             void* _database;
-            mutable unsigned _minLevel;
-            mutable unsigned _maxLevel;
+            mutable std::atomic<unsigned> _minLevel;
+            mutable std::atomic<unsigned> _maxLevel;
             shared_ptr<Image> _emptyImage;
             Options _options;
             std::string _tileFormat;
             bool _forceRGB;
             std::string _name;
+            std::string _filename;
 
             // because no one knows if/when sqlite3 is threadsafe.
+            // Guards _database, which is used for writing and metadata.
             mutable std::mutex _mutex;
 
+            // Pool of read-only connections, each with a prepared tile query.
+            // A thread checks one out for the duration of a read, so reads
+            // run in parallel without touching _mutex.
+            struct Reader;
+            mutable std::vector<Reader*> _readers;
+            mutable std::mutex _readersMutex;
+
+            Reader* acquireReader() const;
+            void releaseReader(Reader*) const;
+
+            // Queue of encoded tiles waiting to be written
+            struct PendingTile
+            {
+                int z, x, y;
+                std::string data;
+            };
+            mutable std::vector<PendingTile> _writeQueue;
+            mutable std::mutex _writeQueueMutex;
+            mutable std::condition_variable _writeQueueCV;
+            mutable std::thread _writer;
+            mutable bool _writerDone = false;
+            mutable void* _insert = nullptr;
+
+            void commitWriteQueue() const;
+            void stopWriter();
+
             bool createTables();
             void computeLevels();
             Result<int> readMaxLevel();
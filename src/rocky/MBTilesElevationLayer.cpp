@@ -29,6 +29,8 @@ MBTilesElevationLayer::construct(const JSON& conf)
     get_to(j, "uri", _options.uri);
     get_to(j, "format", _options.format);
     get_to(j, "compress", _options.compress);
+    get_to(j, "write_batch_size", _options.writeBatchSize);
+    get_to(j, "write_batch_interval", _options.writeBatchInterval);
 }
 
 JSON
@@ -38,6 +40,8 @@ MBTilesElevationLayer::to_json() const
     set(j, "uri", _options.uri);
     set(j, "format", _options.format);
     set(j, "compress", _options.compress);
+    set(j, "write_batch_size", _options.writeBatchSize);
+    set(j, "write_batch_interval", _options.writeBatchInterval);
     return j.dump();
 }
 
@@ -36,6 +36,14 @@ namespace ROCKY_NAMESPACE
         void setCompress(bool value) { _options.compress = value; }
         optional<bool>& compress() { return _options.compress; }
 
+        //! Maximum number of written tiles to commit in one transaction
+        void setWriteBatchSize(unsigned value) { _options.writeBatchSize = value; }
+        optional<unsigned>& writeBatchSize() { return _options.writeBatchSize; }
+
+        //! Maximum time (milliseconds) a written tile waits for its transaction to commit
+        void setWriteBatchInterval(unsigned value) { _options.writeBatchInterval = value; }
+        optional<unsigned>& writeBatchInterval() { return _options.writeBatchInterval; }
+
         //! serialize
         JSON to_json() const override;
 
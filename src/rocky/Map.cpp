@@ -53,11 +53,8 @@ Map::construct(const JSON& conf, const IOOptions& io)
     // Generate a UID.
     _uid = rocky::createUID();
 
-#if 0
     // elevation sampling
-    _elevationPool = ElevationPool::create(_instance);
-    _elevationPool->setMap( this );
-#endif
+    _elevationPool = std::make_shared<ElevationPool>(this);
 
     from_json(conf);
 
@@ -115,13 +112,11 @@ Map::to_json() const
 }
 
 
-#if 0
-ElevationPool*
-Map::getElevationPool() const
+shared_ptr<ElevationPool>
+Map::elevationPool() const
 {
-    return _elevationPool.get();
+    return _elevationPool;
 }
-#endif
 
 Revision
 Map::revision() const
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <rocky/Common.h>
+#include <rocky/ElevationPool.h>
 #include <rocky/Instance.h>
 #include <rocky/Profile.h>
 #include <rocky/Layer.h>
@@ -51,6 +52,9 @@ namespace ROCKY_NAMESPACE
         //! List of attribution strings to be displayed by the application
         std::set<std::string> attributions() const;
 
+        //! Service for sampling the terrain height at arbitrary points
+        shared_ptr<ElevationPool> elevationPool() const;
+
         //! Global application instance
         Instance& instance() { return _instance; }
         const Instance& instance() const { return _instance; }
@@ -108,6 +112,7 @@ namespace ROCKY_NAMESPACE
 
         LayerCollection _imageLayers;
         LayerCollection _elevationLayers;
+        shared_ptr<ElevationPool> _elevationPool;
 
         void construct(const JSON&, const IOOptions& io);
 
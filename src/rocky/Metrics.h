@@ -30,13 +30,15 @@ namespace ROCKY_NAMESPACE { namespace util
 #define TRACY_ON_DEMAND
 #define TRACY_DELAYED_INIT
 #include <Tracy.hpp>
+#include <cstring>
+#include <string>
 
-#define ROCKY_PROFILING_ZONE ZoneNamed( ___tracy_scoped_zone, osgEarth::Util::Metrics::enabled() )
-#define ROCKY_PROFILING_ZONE_NAMED(functionName) ZoneNamedN(___tracy_scoped_zone, functionName, osgEarth::Util::Metrics::enabled())
-#define ROCKY_PROFILING_ZONE_COLOR(color) ZoneScopedC(___tracy_scoped_zone, color, osgEarth::Util::Metrics::enabled())
+#define ROCKY_PROFILING_ZONE ZoneNamed( ___tracy_scoped_zone, ROCKY_NAMESPACE::util::Metrics::enabled() )
+#define ROCKY_PROFILING_ZONE_NAMED(functionName) ZoneNamedN(___tracy_scoped_zone, functionName, ROCKY_NAMESPACE::util::Metrics::enabled())
+#define ROCKY_PROFILING_ZONE_COLOR(color) ZoneNamedC(___tracy_scoped_zone, color, ROCKY_NAMESPACE::util::Metrics::enabled())
 #define ROCKY_PROFILING_ZONE_TEXT(text) _zoneSetText(___tracy_scoped_zone, text)
-#define ROCKY_PROFILING_PLOT(name, value) if (osgEarth::Util::Metrics::enabled()) {TracyPlot(name, value);}
-#define ROCKY_PROFILING_FRAME_MARK if (osgEarth::Util::Metrics::enabled()) {FrameMark;}
+#define ROCKY_PROFILING_PLOT(name, value) if (ROCKY_NAMESPACE::util::Metrics::enabled()) {TracyPlot(name, value);}
+#define ROCKY_PROFILING_FRAME_MARK if (ROCKY_NAMESPACE::util::Metrics::enabled()) {FrameMark;}
 #define ROCKY_LOCKABLE(type, varname) TracyLockable(type, varname)
 #define ROCKY_LOCKABLE_NAMED(type, varname, desc) TracyLockableN(type, varname, desc)
 #define ROCKY_LOCKABLE_BASE( type ) LockableBase( type )
@@ -59,6 +61,7 @@ inline void _zoneSetText(tracy::ScopedZone& zone, const std::string& text) {
 #define ROCKY_PROFILING_PLOT(name, value)
 #define ROCKY_PROFILING_FRAME_MARK
 #define ROCKY_LOCKABLE(type, varname) type varname
+#define ROCKY_LOCKABLE_NAMED(type, varname, desc) type varname
 #define ROCKY_LOCKABLE_BASE( type ) type
 #define ROCKY_PROFILING_GPU_ZONE(name)
 
@@ -8,6 +8,11 @@
 #include "Metrics.h"
 #include "ElevationLayer.h"
 #include "ImageLayer.h"
+#include "Threading.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #define LC "[TerrainTileModelFactory] "
 
@@ -15,22 +20,80 @@ using namespace ROCKY_NAMESPACE;
 
 namespace
 {
-    void replace_nodata_values(GeoHeightfield& geohf)
+    // Heightfield with its NO_DATA samples set to zero. Heightfields coming
+    // from a layer may be shared with its caches and with other threads, so
+    // this never changes the input; it copies it if there's anything to replace.
+    GeoHeightfield replace_nodata_values(const GeoHeightfield& geohf)
     {
         auto grid = geohf.heightfield();
-        if (grid)
+        if (!grid)
+            return geohf;
+
+        const float* begin = grid->data<float>();
+        const float* end = begin + grid->width() * grid->height();
+        if (std::find(begin, end, NO_DATA_VALUE) == end)
+            return geohf;
+
+        auto copy = Heightfield::create(grid->width(), grid->height());
+        std::replace_copy(begin, end, copy->data<float>(), NO_DATA_VALUE, 0.0f);
+        return GeoHeightfield(copy, geohf.extent());
+    }
+
+    // Sobel-filters a grid of heights with a one-sample border on every side
+    // ((width+2) x (height+2), row 0 at the south) into a normal map. Each
+    // pixel holds the normal in the tile's tangent frame (x=east, y=north,
+    // z=up), scaled into [0..1]. spacing[r] is the ground distance between
+    // the samples of row r, in meters.
+    shared_ptr<Image> sobel(
+        const std::vector<float>& heights,
+        unsigned width,
+        unsigned height,
+        const std::vector<glm::dvec2>& spacing)
+    {
+        auto image = Image::create(Image::R8G8B8A8_UNORM, width, height);
+
+        const unsigned stride = width + 2;
+        std::vector<float> gx(width), gy(width);
+
+        for (unsigned r = 0; r < height; ++r)
         {
-            for (unsigned col = 0; col < grid->height(); ++col)
+            const float* south = &heights[r * stride];
+            const float* center = south + stride;
+            const float* north = center + stride;
+
+            // gradients of the whole row; no branches, so this vectorizes
+            for (unsigned c = 0; c < width; ++c)
             {
-                for (unsigned row = 0; row < grid->width(); ++row)
-                {
-                    if (grid->heightAt(col, row) == NO_DATA_VALUE)
-                    {
-                        grid->heightAt(col, row) = 0.0f;
-                    }
-                }
+                gx[c] =
+                    (south[c + 2] + 2.0f * center[c + 2] + north[c + 2]) -
+                    (south[c] + 2.0f * center[c] + north[c]);
+
+                gy[c] =
+                    (north[c] + 2.0f * north[c + 1] + north[c + 2]) -
+                    (south[c] + 2.0f * south[c + 1] + south[c + 2]);
+            }
+
+            // normal = normalize(-dz/dx, -dz/dy, 1)
+            const float sx = -1.0f / (8.0f * (float)spacing[r].x);
+            const float sy = -1.0f / (8.0f * (float)spacing[r].y);
+
+            unsigned char* out = image->data<unsigned char>() + r * width * 4;
+
+            for (unsigned c = 0; c < width; ++c)
+            {
+                float nx = gx[c] * sx;
+                float ny = gy[c] * sy;
+                float nz = 1.0f / std::sqrt(nx * nx + ny * ny + 1.0f);
+                nx *= nz, ny *= nz;
+
+                out[c * 4 + 0] = (unsigned char)((nx * 0.5f + 0.5f) * 255.0f + 0.5f);
+                out[c * 4 + 1] = (unsigned char)((ny * 0.5f + 0.5f) * 255.0f + 0.5f);
+                out[c * 4 + 2] = (unsigned char)((nz * 0.5f + 0.5f) * 255.0f + 0.5f);
+                out[c * 4 + 3] = 255;
             }
         }
+
+        return image;
     }
 }
 
@@ -150,19 +213,44 @@ TerrainTileModelFactory::createTileModel(
     model.key = key;
     model.revision = map->revision();
 
-    // assemble all the components:
-    addColorLayers(model, map, key, manifest, io, false);
-
     unsigned border = 0u;
-    addElevation(model, map, key, manifest, border, io);
+
+    if (fetchSchedulerName.empty())
+    {
+        // assemble all the components:
+        addColorLayers(model, map, key, manifest, io, false);
+        if (addElevation(model, map, key, manifest, border, io))
+            addNeighborData(model, map, key, io);
+    }
+    else
+    {
+        // fetch the elevation in the background while we assemble the color layers.
+        // Always join before returning: the job refers to our arguments.
+        auto elevation = jobs::dispatch([&](Cancelable&)
+            {
+                TerrainTileModel temp;
+                if (addElevation(temp, map, key, manifest, border, io))
+                    addNeighborData(temp, map, key, io);
+                return temp;
+            },
+            jobs::context{ "elevation " + key.str(), jobs::get_pool(fetchSchedulerName) });
+
+        addColorLayers(model, map, key, manifest, io, false);
+
+        auto temp = elevation.join();
+        model.elevation = std::move(temp.elevation);
+        model.normalMap = std::move(temp.normalMap);
+    }
 
     return std::move(model);
 }
 
 namespace
 {
-    void addImageLayer(const TileKey& requested_key, std::shared_ptr<ImageLayer> layer, bool fallback, TerrainTileModel& model, const IOOptions& io)
+    TerrainTileModel::ColorLayer fetchImageLayer(const TileKey& requested_key, std::shared_ptr<ImageLayer> layer, bool fallback, const IOOptions& io)
     {
+        TerrainTileModel::ColorLayer m;
+
         Result<GeoImage> result;
 
         TileKey key = requested_key;
@@ -180,16 +268,10 @@ namespace
 
         if (result.value.valid())
         {
-            TerrainTileModel::ColorLayer m;            
             m.layer = layer;
             m.revision = layer->revision();
             m.image = result.value;
             m.key = key;
-            model.colorLayers.emplace_back(std::move(m));
-            if (layer->dynamic())
-            {
-                model.requiresUpdate = true;
-            }
         }
 
         // ResourceUnavailable just means the driver could not produce data
@@ -198,6 +280,58 @@ namespace
         {
             Log()->warn("Problem getting data from \"" + layer->name() + "\" : " + result.status.message);
         }
+
+        return m;
+    }
+
+    void addImageLayers(
+        const TileKey& key,
+        const std::vector<std::shared_ptr<ImageLayer>>& layers,
+        bool fallback,
+        TerrainTileModel& model,
+        const IOOptions& io,
+        const std::string& scheduler)
+    {
+        std::vector<TerrainTileModel::ColorLayer> results(layers.size());
+
+        if (scheduler.empty() || layers.size() == 1)
+        {
+            for (unsigned i = 0; i < layers.size(); ++i)
+                results[i] = fetchImageLayer(key, layers[i], fallback, io);
+        }
+        else
+        {
+            // Fan out so the tile's latency is that of the slowest layer rather
+            // than the sum of them all. The calling thread fetches the first layer
+            // itself. Always join them all: the jobs refer to our arguments.
+            auto group = jobs::jobgroup::create();
+            jobs::context con{ "fetch " + key.str(), jobs::get_pool(scheduler), {}, group };
+
+            for (unsigned i = 1; i < layers.size(); ++i)
+            {
+                jobs::dispatch([&, i]()
+                    {
+                        results[i] = fetchImageLayer(key, layers[i], fallback, io);
+                    }, con);
+            }
+
+            results[0] = fetchImageLayer(key, layers[0], fallback, io);
+
+            group->join();
+        }
+
+        // keep the layer order:
+        for (unsigned i = 0; i < layers.size(); ++i)
+        {
+            if (results[i].image.valid())
+            {
+                if (layers[i]->dynamic())
+                {
+                    model.requiresUpdate = true;
+                }
+                model.colorLayers.emplace_back(std::move(results[i]));
+            }
+        }
     }
 }
 
@@ -242,7 +376,7 @@ TerrainTileModelFactory::addColorLayers(
     {
         // if only one layer intersects we will not need to composite
         // so just get the raw data for this key if there is any.
-        addImageLayer(key, intersecting_layers.front(), false, model, io);
+        addImageLayers(key, intersecting_layers, false, model, io, {});
     }
 
     else if (intersecting_layers.size() > 1)
@@ -262,10 +396,7 @@ TerrainTileModelFactory::addColorLayers(
 
         if (data_maybe)
         {
-            for (auto layer : intersecting_layers)
-            {
-                addImageLayer(key, layer, true, model, io);
-            }
+            addImageLayers(key, intersecting_layers, true, model, io, fetchSchedulerName);
 
             // now composite them.
             if (compositeColorLayers && model.colorLayers.size() > 1)
@@ -312,38 +443,307 @@ TerrainTileModelFactory::createElevationModel(
 
     TerrainTileModel::Elevation model;
 
-    auto layer = map->layers().firstOfType<ElevationLayer>();
+    // Collect the open layers with data somewhere in this tile, at this
+    // resolution or a lower one.
+    ElevationLayerVector layers;
+    for (auto& layer : map->layers().ofType<ElevationLayer>())
+    {
+        if (layer->isOpen() && layer->bestAvailableTileKey(key).valid())
+        {
+            layers.push_back(layer);
+        }
+    }
+
+    // The map revision changes when layers come and go:
+    Revision revision = map->revision();
+    for (auto& layer : layers)
+    {
+        revision += layer->revision();
+    }
 
-    if (layer != nullptr && 
-        layer->isOpen() &&
-        layer->isKeyInLegalRange(key) &&
-        layer->mayHaveData(key))
+    if (elevationCache)
     {
-        auto result = layer->createHeightfield(key, io);
+        auto cached = elevationCache->get(key);
+        if (cached.key == key && cached.revision == revision)
+            return cached;
+    }
 
-        if (result.status.ok())
+    bool cacheable = true;
+
+    if (layers.size() == 1)
+    {
+        // Only one layer intersects, so use its heightfield as-is.
+        auto& layer = layers.front();
+
+        if (layer->isKeyInLegalRange(key) &&
+            layer->mayHaveData(key))
         {
-            replace_nodata_values(result.value);
+            auto result = layer->createHeightfield(key, io);
+
+            if (result.status.ok())
+            {
+                model.heightfield = replace_nodata_values(result.value);
+            }
 
-            model.heightfield = std::move(result.value);
-            model.revision = layer->revision();
-            model.key = key;
+            // ResourceUnavailable just means the driver could not produce data
+            // for the tilekey; it is not an actual read error.
+            else if (result.status.code != Status::ResourceUnavailable)
+            {
+                Log()->warn("Problem getting data from \"" + layer->name() + "\" : " + result.status.message);
+                cacheable = false;
+            }
         }
+    }
 
-        // ResourceUnavailable just means the driver could not produce data
-        // for the tilekey; it is not an actual read error.
-        else if (result.status.code != Status::ResourceUnavailable)
+    else if (layers.size() > 1)
+    {
+        // Composite them all (base DEM, insets, offsets) at the resolution of the
+        // most detailed one. If every layer would only contribute fallback data,
+        // there's nothing new here and the tile keeps its parent's elevation.
+        unsigned tileSize = 0u;
+        for (auto& layer : layers)
         {
-            Log()->warn("Problem getting data from \"" + layer->name() + "\" : " + result.status.message);
+            tileSize = std::max(tileSize, layer->tileSize().value());
+        }
+
+        auto hf = Heightfield::create(tileSize, tileSize);
+
+        if (layers.populateHeightfield(hf, nullptr, key, Profile(), Image::BILINEAR, io))
+        {
+            model.heightfield = GeoHeightfield(hf, key.extent());
         }
     }
 
+    model.revision = revision;
+    model.key = key;
+
+    // remember empty results too, so neighbors don't look for them again
+    if (elevationCache && cacheable && !io.canceled())
+    {
+        elevationCache->put(key, model);
+    }
+
     return model;
 }
 
 
 
 
+void
+TerrainTileModelFactory::addNeighborData(
+    TerrainTileModel& model,
+    const Map* map,
+    const TileKey& key,
+    const IOOptions& io) const
+{
+    if (!normalizeEdges && !createNormalMaps)
+        return;
+
+    ROCKY_PROFILING_ZONE;
+
+    // Elevation of the neighboring tiles at the same level. Their heightfields
+    // were most likely created just now for their own tiles, and come from the
+    // elevation layers' L2 caches. Edge normalization also needs the diagonal
+    // neighbors, which share the corners.
+    std::vector<TileKey> keys;
+    std::vector<GeoHeightfield> neighbors;
+
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            if ((x == 0 && y == 0) || (x != 0 && y != 0 && !normalizeEdges))
+                continue;
+
+            // keys wrap around the profile, so skip repeats
+            auto neighborKey = key.createNeighborKey(x, y);
+            if (neighborKey == key || std::find(keys.begin(), keys.end(), neighborKey) != keys.end())
+                continue;
+
+            keys.push_back(neighborKey);
+
+            auto neighbor = createElevationModel(map, neighborKey, io);
+            if (neighbor.heightfield.valid())
+                neighbors.emplace_back(std::move(neighbor.heightfield));
+        }
+    }
+
+    if (io.canceled())
+        return;
+
+    if (normalizeEdges)
+        normalizeElevationEdges(model, neighbors);
+
+    // The normal map reads across the edges into the neighbors' own heights.
+    // So with normalized edges, adjacent tiles of the same level filter the
+    // same samples along their shared edge and come out with the same normals.
+    if (createNormalMaps)
+        addNormalMap(model, neighbors);
+}
+
+void
+TerrainTileModelFactory::normalizeElevationEdges(
+    TerrainTileModel& model,
+    const std::vector<GeoHeightfield>& neighbors) const
+{
+    auto& geohf = model.elevation.heightfield;
+    if (!geohf.valid() || neighbors.empty())
+        return;
+
+    auto source = geohf.heightfield();
+    const unsigned width = source->width();
+    const unsigned height = source->height();
+    if (width < 2 || height < 2)
+        return;
+
+    // Work on a copy; the original may be shared with the layer caches, and
+    // the neighbors read it to normalize their own edges.
+    auto hf = Heightfield::create(width, height);
+    std::memcpy(hf->data<unsigned char>(), source->data<unsigned char>(), source->sizeInBytes());
+
+    const GeoExtent& extent = geohf.extent();
+
+    // Every tile that contains an edge sample (this one, the one across the edge,
+    // and at the corners the diagonal one) averages the same heights there, so
+    // they all end up with the same value.
+    auto normalize = [&](unsigned c, unsigned r)
+        {
+            double x = c == width - 1 ? extent.xmax() : extent.xmin() + extent.width() * (double)c / (double)(width - 1);
+            double y = r == height - 1 ? extent.ymax() : extent.ymin() + extent.height() * (double)r / (double)(height - 1);
+
+            double sum = source->heightAt(c, r);
+            unsigned count = 1;
+
+            for (auto& neighbor : neighbors)
+            {
+                float h = neighbor.heightAtLocation(x, y, Image::BILINEAR);
+                if (h != NO_DATA_VALUE)
+                {
+                    sum += h;
+                    ++count;
+                }
+            }
+
+            hf->heightAt(c, r) = (float)(sum / (double)count);
+        };
+
+    for (unsigned c = 0; c < width; ++c)
+        normalize(c, 0), normalize(c, height - 1);
+
+    for (unsigned r = 1; r < height - 1; ++r)
+        normalize(0, r), normalize(width - 1, r);
+
+    model.elevation.heightfield = GeoHeightfield(hf, extent);
+}
+
+bool
+TerrainTileModelFactory::addNormalMap(
+    TerrainTileModel& model,
+    const std::vector<GeoHeightfield>& neighbors) const
+{
+    auto& geohf = model.elevation.heightfield;
+    if (!geohf.valid())
+        return false;
+
+    auto hf = geohf.heightfield();
+    const unsigned width = hf->width();
+    const unsigned height = hf->height();
+    if (width < 3 || height < 3)
+        return false;
+
+    const GeoExtent& extent = geohf.extent();
+    const double dx = extent.width() / (double)(width - 1);
+    const double dy = extent.height() / (double)(height - 1);
+
+    // Copy the heights into a grid with a one-sample border, so that the
+    // filter reaches across the tile edges.
+    const unsigned stride = width + 2;
+    std::vector<float> heights(stride * (height + 2), NO_DATA_VALUE);
+
+    for (unsigned r = 0; r < height; ++r)
+    {
+        std::memcpy(&heights[(r + 1) * stride + 1], hf->data<float>() + r * width, width * sizeof(float));
+    }
+
+    // Fill the border from the neighboring tiles:
+    auto fill = [&](unsigned c, unsigned r)
+        {
+            double x = extent.xmin() + dx * ((double)c - 1.0);
+            double y = extent.ymin() + dy * ((double)r - 1.0);
+            for (auto& neighbor : neighbors)
+            {
+                float h = neighbor.heightAtLocation(x, y, Image::BILINEAR);
+                if (h != NO_DATA_VALUE)
+                {
+                    heights[r * stride + c] = h;
+                    return;
+                }
+            }
+        };
+
+    for (unsigned c = 0; c <= width + 1; ++c)
+        fill(c, 0), fill(c, height + 1);
+
+    for (unsigned r = 1; r <= height; ++r)
+        fill(0, r), fill(width + 1, r);
+
+    // Extrapolate what the neighbors could not provide (edges of the map or
+    // of the data, and the corners) so the edge slopes stay consistent.
+    auto at = [&](unsigned c, unsigned r) -> float& { return heights[r * stride + c]; };
+
+    for (unsigned c = 1; c <= width; ++c)
+    {
+        if (at(c, 0) == NO_DATA_VALUE)
+            at(c, 0) = 2.0f * at(c, 1) - at(c, 2);
+        if (at(c, height + 1) == NO_DATA_VALUE)
+            at(c, height + 1) = 2.0f * at(c, height) - at(c, height - 1);
+    }
+
+    for (unsigned r = 0; r <= height + 1; ++r)
+    {
+        if (at(0, r) == NO_DATA_VALUE)
+            at(0, r) = 2.0f * at(1, r) - at(2, r);
+        if (at(width + 1, r) == NO_DATA_VALUE)
+            at(width + 1, r) = 2.0f * at(width, r) - at(width - 1, r);
+    }
+
+    // Ground distance between samples, per row (it shrinks toward the poles
+    // in geographic and mercator profiles). Measure it in ECEF, where it
+    // doesn't depend on the kind of SRS.
+    std::vector<glm::dvec2> spacing(height, glm::dvec2(dx, dy));
+
+    auto xform = extent.srs().to(SRS::ECEF);
+    if (xform.valid())
+    {
+        const double xmid = extent.xmin() + 0.5 * extent.width();
+
+        std::vector<glm::dvec3> points(height * 3);
+        for (unsigned r = 0; r < height; ++r)
+        {
+            double y = extent.ymin() + dy * (double)r;
+            points[r * 3 + 0] = glm::dvec3(xmid, y, 0.0);
+            points[r * 3 + 1] = glm::dvec3(xmid + dx, y, 0.0);
+            points[r * 3 + 2] = glm::dvec3(xmid, y + dy, 0.0);
+        }
+
+        if (xform.transformArray(points.data(), points.size()))
+        {
+            for (unsigned r = 0; r < height; ++r)
+            {
+                spacing[r].x = glm::length(points[r * 3 + 1] - points[r * 3]);
+                spacing[r].y = glm::length(points[r * 3 + 2] - points[r * 3]);
+            }
+        }
+    }
+
+    model.normalMap.image = GeoImage(sobel(heights, width, height, spacing), extent);
+    model.normalMap.key = model.elevation.key;
+    model.normalMap.revision = model.elevation.revision;
+    model.normalMap.matrix = model.elevation.matrix;
+
+    return true;
+}
+
 bool
 TerrainTileModelFactory::addElevation(
     TerrainTileModel& model,
@@ -378,31 +778,7 @@ TerrainTileModelFactory::addElevation(
     if (!needElevation)
         return false;
 
-    auto layer = map->layers().firstOfType<ElevationLayer>();
-
-    if (layer != nullptr &&
-        layer->isOpen() &&
-        layer->isKeyInLegalRange(key) &&
-        layer->mayHaveData(key))
-    {
-        auto result = layer->createHeightfield(key, io);
-
-        if (result.status.ok())
-        {
-            replace_nodata_values(result.value);
-
-            model.elevation.heightfield = std::move(result.value);
-            model.elevation.revision = layer->revision();
-            model.elevation.key = key;
-        }
-
-        // ResourceUnavailable just means the driver could not produce data
-        // for the tilekey; it is not an actual read error.
-        else if (result.status.code != Status::ResourceUnavailable)
-        {
-            Log()->warn("Problem getting data from \"" + layer->name() + "\" : " + result.status.message);
-        }
-    }
+    model.elevation = createElevationModel(map, key, io);
 
     return model.elevation.heightfield.valid();
 }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <rocky/TerrainTileModel.h>
+#include <rocky/LRUCache.h>
 #include <unordered_map>
 
 namespace ROCKY_NAMESPACE
@@ -25,6 +26,23 @@ namespace ROCKY_NAMESPACE
         //! Whether to composite all color layers into one
         bool compositeColorLayers = true;
 
+        //! Whether to generate a normal map from each tile's elevation data
+        bool createNormalMaps = false;
+
+        //! Whether to average the heights along each tile's edges with those of
+        //! its neighbors, so that adjacent tiles meet without cracks or seams
+        bool normalizeEdges = false;
+
+        //! Cache of elevation tiles, to share among the factories loading the same
+        //! terrain. Neighboring tiles read each other's elevation to build normal maps
+        //! and normalize edges, and compositing several layers is costly. Optional.
+        using ElevationCache = util::LRUCache<TileKey, TerrainTileModel::Elevation>;
+        shared_ptr<ElevationCache> elevationCache;
+
+        //! Name of the job pool in which to fetch layer data concurrently.
+        //! If empty, layers are fetched one after another in the calling thread.
+        std::string fetchSchedulerName;
+
     public:
         TerrainTileModelFactory();
 
@@ -61,5 +79,19 @@ namespace ROCKY_NAMESPACE
             const CreateTileManifest& manifest,
             unsigned border,
             const IOOptions& io);
+
+        void addNeighborData(
+            TerrainTileModel& model,
+            const Map* map,
+            const TileKey& key,
+            const IOOptions& io) const;
+
+        void normalizeElevationEdges(
+            TerrainTileModel& model,
+            const std::vector<GeoHeightfield>& neighbors) const;
+
+        bool addNormalMap(
+            TerrainTileModel& model,
+            const std::vector<GeoHeightfield>& neighbors) const;
     };
 }
@@ -6,6 +6,9 @@
 #pragma once
 #include <rocky/Common.h>
 #include <unordered_set>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
 
 #define WEEJOBS_NAMESPACE jobs
 #define WEEJOBS_EXPORT ROCKY_EXPORT
@@ -115,6 +118,105 @@ namespace ROCKY_NAMESPACE
             T _key;
             bool _active;
         };
+
+        /**
+        * Coalesces concurrent requests for the same keyed resource so that
+        * only one thread does the work and any others that ask for the same
+        * key in the meantime wait for, and share, its result.
+        */
+        template<typename K, typename V>
+        class Coalescer
+        {
+        public:
+            //! Runs "func" for "key", unless another thread is already running
+            //! it for the same key, in which case wait for and return its result.
+            //! @param key Key identifying the resource
+            //! @param func Function that creates the resource
+            //! @param cancelable Cancelation for the calling thread. If the thread
+            //!   doing the work is canceled, the waiters do not share its result
+            //!   and try again themselves; if a waiter is canceled, it stops
+            //!   waiting and calls "func" itself (which should return promptly).
+            V run(const K& key, const std::function<V()>& func, const Cancelable* cancelable = nullptr)
+            {
+                for (;;)
+                {
+                    std::shared_ptr<Flight> flight;
+                    bool leader = false;
+                    {
+                        std::lock_guard<std::mutex> lock(_m);
+                        auto& entry = _flights[key];
+                        if (!entry)
+                        {
+                            entry = std::make_shared<Flight>();
+                            leader = true;
+                        }
+                        flight = entry;
+                    }
+
+                    if (leader)
+                    {
+                        V value;
+                        try {
+                            value = func();
+                        }
+                        catch (...) {
+                            land(key, *flight, nullptr);
+                            throw;
+                        }
+                        land(key, *flight, (cancelable && cancelable->canceled()) ? nullptr : &value);
+                        return value;
+                    }
+                    else
+                    {
+                        std::unique_lock<std::mutex> lock(flight->m);
+                        while (!flight->done)
+                        {
+                            if (cancelable && cancelable->canceled())
+                            {
+                                lock.unlock();
+                                return func();
+                            }
+                            flight->cv.wait_for(lock, std::chrono::milliseconds(100));
+                        }
+
+                        if (flight->shared)
+                            return flight->value;
+
+                        // the leader was canceled; try again.
+                    }
+                }
+            }
+
+        private:
+            struct Flight
+            {
+                std::mutex m;
+                std::condition_variable cv;
+                bool done = false;
+                bool shared = false;
+                V value;
+            };
+
+            std::mutex _m;
+            std::unordered_map<K, std::shared_ptr<Flight>> _flights;
+
+            // completes a flight, sharing "value" with the waiters if it's not null
+            void land(const K& key, Flight& flight, const V* value)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(_m);
+                    _flights.erase(key);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(flight.m);
+                    flight.shared = (value != nullptr);
+                    if (value)
+                        flight.value = *value;
+                    flight.done = true;
+                }
+                flight.cv.notify_all();
+            }
+        };
     }
 
 } // namepsace rocky::util
@@ -5,10 +5,14 @@
  */
 #include "TileLayer.h"
 #include "TileKey.h"
+#include "Image.h"
 #include "Map.h"
+#include "Utils.h"
 #include "rtree.h"
 #include "json.h"
 
+#include <cstdint>
+
 using namespace ROCKY_NAMESPACE;
 using namespace ROCKY_NAMESPACE::util;
 
@@ -17,6 +21,73 @@ using namespace ROCKY_NAMESPACE::util;
 namespace
 {
     using DataExtentsIndex = RTree<DataExtent, double, 2>;
+
+    // Header preceding the pixel data of a raster stored in the cache
+    struct CachedRasterHeader
+    {
+        std::uint32_t pixelFormat;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t depth;
+        std::uint32_t compressed;
+    };
+
+    std::string encodeRaster(const Image& image)
+    {
+        CachedRasterHeader header;
+        header.pixelFormat = (std::uint32_t)image.pixelFormat();
+        header.width = image.width();
+        header.height = image.height();
+        header.depth = image.depth();
+        header.compressed = 0;
+
+        std::string pixels(image.data<char>(), image.sizeInBytes());
+
+#ifdef ROCKY_HAS_ZLIB
+        std::stringstream buf;
+        if (ZLibCompressor().compress(pixels, buf))
+        {
+            pixels = buf.str();
+            header.compressed = 1;
+        }
+#endif
+
+        std::string output(reinterpret_cast<const char*>(&header), sizeof(header));
+        output += pixels;
+        return output;
+    }
+
+    shared_ptr<Image> decodeRaster(const std::string& data)
+    {
+        if (data.size() < sizeof(CachedRasterHeader))
+            return nullptr;
+
+        CachedRasterHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+
+        if (header.pixelFormat >= (std::uint32_t)Image::NUM_PIXEL_FORMATS)
+            return nullptr;
+
+        std::string pixels = data.substr(sizeof(header));
+
+        if (header.compressed)
+        {
+#ifdef ROCKY_HAS_ZLIB
+            std::stringstream buf(pixels);
+            if (!ZLibCompressor().decompress(buf, pixels))
+                return nullptr;
+#else
+            return nullptr;
+#endif
+        }
+
+        auto image = Image::create((Image::PixelFormat)header.pixelFormat, header.width, header.height, header.depth);
+        if (pixels.size() != image->sizeInBytes())
+            return nullptr;
+
+        memcpy(image->data<char>(), pixels.data(), pixels.size());
+        return image;
+    }
 }
 
 TileLayer::TileLayer() :
@@ -110,7 +181,7 @@ TileLayer::openImplementation(const IOOptions& io)
     auto result = super::openImplementation(io);
     if (result.ok())
     {
-        //todo
+        establishCacheSettings();
     }
     return result;
 }
@@ -188,7 +259,65 @@ TileLayer::openForWriting()
 void
 TileLayer::establishCacheSettings()
 {
-    //nop
+    // Use the user's cache ID if there is one; otherwise derive one from the
+    // layer configuration so that changing the data source changes the bin.
+    if (_cacheid.has_value())
+        _runtimeCacheId = _cacheid.value();
+    else
+        _runtimeCacheId = make_string() << std::hex << hashString(to_json());
+
+    CachePolicy policy = cachePolicy();
+    policy.mergeAndOverride(hints().cachePolicy);
+
+    // dynamic data is never cached.
+    if (dynamic())
+        policy = CachePolicy::NO_CACHE;
+
+    _runtimeCachePolicy = policy;
+}
+
+bool
+TileLayer::isCacheOnly() const
+{
+    return _runtimeCachePolicy.value().isCacheOnly();
+}
+
+Result<shared_ptr<Image>>
+TileLayer::readRasterFromCache(const TileKey& key, const IOOptions& io, bool& out_expired) const
+{
+    out_expired = false;
+
+    auto& policy = _runtimeCachePolicy.value();
+    if (!policy.isCacheReadable())
+        return Status(Status::ServiceUnavailable);
+
+    auto cache = io.services.cache();
+    if (!cache)
+        return Status(Status::ServiceUnavailable);
+
+    auto r = cache->read(_runtimeCacheId, key.profile().getHorizSignature() + "/" + key.str());
+    if (r.status.failed())
+        return r.status;
+
+    auto raster = decodeRaster(r.value.data);
+    if (!raster)
+        return Status(Status::GeneralError, "Corrupt cache record for " + key.str());
+
+    out_expired = policy.isExpired(r.value.lastModified);
+    return raster;
+}
+
+void
+TileLayer::writeRasterToCache(const TileKey& key, const Image& raster, const IOOptions& io) const
+{
+    if (!_runtimeCachePolicy.value().isCacheWriteable() || !raster.valid() || io.canceled())
+        return;
+
+    auto cache = io.services.cache();
+    if (cache)
+    {
+        cache->write(_runtimeCacheId, key.profile().getHorizSignature() + "/" + key.str(), encodeRaster(raster));
+    }
 }
 
 const Profile&
@@ -13,6 +13,8 @@
 
 namespace ROCKY_NAMESPACE
 {
+    class Image;
+
     /**
      * A layer that comprises the terrain skin (image or elevation layer)
      */
@@ -160,6 +162,27 @@ namespace ROCKY_NAMESPACE
         // cache key for metadata
         std::string getMetadataKey(const Profile&) const;
 
+        //! Reads a tile raster from the cache, if there is a cache and the
+        //! layer's cache policy allows reading.
+        //! @param key Tile key of the raster to read
+        //! @param io IO options supplying the cache service
+        //! @param out_expired Set to true if the record exists but is expired
+        //!   according to the cache policy (the raster is still returned)
+        Result<shared_ptr<Image>> readRasterFromCache(
+            const TileKey& key,
+            const IOOptions& io,
+            bool& out_expired) const;
+
+        //! Writes a tile raster to the cache, if there is a cache and the
+        //! layer's cache policy allows writing.
+        void writeRasterToCache(
+            const TileKey& key,
+            const Image& raster,
+            const IOOptions& io) const;
+
+        //! Whether the cache policy says to ONLY read from the cache
+        bool isCacheOnly() const;
+
         optional<unsigned> _minLevel = 0;
         optional<unsigned> _maxLevel = 23;
         optional<double> _minResolution;
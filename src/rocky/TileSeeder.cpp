@@ -0,0 +1,383 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#include "TileSeeder.h"
+#include "Map.h"
+#include "ImageLayer.h"
+#include "ElevationLayer.h"
+#include "Feature.h"
+#include "Threading.h"
+#include "Utils.h"
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+using namespace ROCKY_NAMESPACE;
+using namespace ROCKY_NAMESPACE::util;
+
+#define LC "[TileSeeder] "
+
+namespace
+{
+    // Seed in batches: after each one we report progress and update the
+    // checkpoint, so an interrupted run loses at most one batch of work.
+    const unsigned keys_per_batch_per_thread = 16u;
+
+    bool readCheckpoint(const std::string& filename, const std::string& signature, std::size_t& out_completed)
+    {
+        std::string data;
+        if (!readFromFile(data, filename))
+            return false;
+
+        auto j = parse_json(data);
+        std::string sig;
+        std::size_t completed = 0;
+        get_to(j, "signature", sig);
+        get_to(j, "completed", completed);
+        if (sig != signature)
+            return false;
+
+        out_completed = completed;
+        return true;
+    }
+
+    void writeCheckpoint(const std::string& filename, const std::string& signature, std::size_t completed)
+    {
+        auto j = json::object();
+        set(j, "signature", signature);
+        set(j, "completed", completed);
+        if (!writeToFile(j.dump(), filename))
+        {
+            Log()->warn(LC "Failed to write checkpoint file \"" + filename + "\"");
+        }
+    }
+
+    // Whether the segment ab touches the box (Liang-Barsky clipping)
+    bool segmentIntersectsBox(const glm::dvec3& a, const glm::dvec3& b, double xmin, double ymin, double xmax, double ymax)
+    {
+        double dx = b.x - a.x, dy = b.y - a.y;
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { a.x - xmin, xmax - a.x, a.y - ymin, ymax - a.y };
+        double t0 = 0.0, t1 = 1.0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (p[i] == 0.0)
+            {
+                // parallel to this edge; outside means no hit
+                if (q[i] < 0.0)
+                    return false;
+            }
+            else
+            {
+                double t = q[i] / p[i];
+                if (p[i] < 0.0)
+                {
+                    if (t > t1) return false;
+                    t0 = std::max(t0, t);
+                }
+                else
+                {
+                    if (t < t0) return false;
+                    t1 = std::min(t1, t);
+                }
+            }
+        }
+        return true;
+    }
+
+    // Whether a polygon or multipolygon touches the box
+    bool intersects(const Geometry& geometry, double xmin, double ymin, double xmax, double ymax)
+    {
+        // box inside the polygon:
+        if (geometry.contains(xmin, ymin) || geometry.contains(xmax, ymin) ||
+            geometry.contains(xmax, ymax) || geometry.contains(xmin, ymax))
+        {
+            return true;
+        }
+
+        // polygon inside the box, or the two overlap partway:
+        Geometry::const_iterator iter(geometry);
+        while (iter.hasMore())
+        {
+            auto& points = iter.next().points;
+            for (std::size_t i = 0; i < points.size(); ++i)
+            {
+                if (segmentIntersectsBox(points[i], points[(i + 1) % points.size()], xmin, ymin, xmax, ymax))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+std::vector<shared_ptr<TileLayer>>
+TileSeeder::layersToSeed(const Map* map) const
+{
+    std::vector<shared_ptr<TileLayer>> result;
+
+    if (!layers.empty())
+    {
+        result = layers;
+    }
+    else
+    {
+        for (auto& layer : map->layers().ofType<ImageLayer>())
+            result.push_back(layer);
+        for (auto& layer : map->layers().ofType<ElevationLayer>())
+            result.push_back(layer);
+    }
+
+    result.erase(std::remove_if(result.begin(), result.end(),
+        [](const shared_ptr<TileLayer>& layer) { return !layer || !layer->isOpen(); }),
+        result.end());
+
+    return result;
+}
+
+std::string
+TileSeeder::signature(const Map* map, const std::vector<shared_ptr<TileLayer>>& layers) const
+{
+    // Identifies the work of a run, so we never resume from the checkpoint
+    // of a run with different settings.
+    std::string desc = map->profile().getHorizSignature();
+    desc += "|" + (extent.valid() ? extent.toString() : std::string("*"));
+    if (area)
+    {
+        std::string coords;
+        Geometry::const_iterator iter(area->geometry);
+        while (iter.hasMore())
+            for (auto& point : iter.next().points)
+                coords += std::to_string(point.x) + "," + std::to_string(point.y) + ";";
+        desc += "|" + std::to_string(hashString(coords));
+    }
+    desc += "|" + std::to_string(minLevel) + "-" + std::to_string(maxLevel);
+    for (auto& layer : layers)
+        desc += "|" + std::to_string(hashString(layer->to_json()));
+
+    return std::to_string(hashString(desc));
+}
+
+void
+TileSeeder::collectKeys(const Map* map, unsigned level, std::vector<TileKey>& out_keys) const
+{
+    auto& profile = map->profile();
+    ROCKY_SOFT_ASSERT_AND_RETURN(profile.valid(), void());
+
+    std::vector<TileKey> keys;
+
+    GeoExtent bounds = extent;
+    if (!bounds.valid() && area)
+        bounds = area->extent;
+
+    if (bounds.valid())
+        TileKey::getIntersectingKeys(bounds, level, profile, keys);
+    else
+        Profile::getAllKeysAtLOD(level, profile, keys);
+
+    // drop the keys that miss the area polygon:
+    if (area)
+    {
+        keys.erase(std::remove_if(keys.begin(), keys.end(), [&](const TileKey& key)
+            {
+                auto tile = key.extent().transform(area->srs);
+                return tile.valid() && !intersects(area->geometry, tile.xMin(), tile.yMin(), tile.xMax(), tile.yMax());
+            }),
+            keys.end());
+    }
+
+    // the order has to be repeatable for a checkpoint to mean anything:
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    out_keys.insert(out_keys.end(), keys.begin(), keys.end());
+}
+
+std::size_t
+TileSeeder::count(const Map* map) const
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(map, 0);
+
+    std::size_t total = 0;
+    std::vector<TileKey> keys;
+    for (unsigned level = minLevel; level <= maxLevel; ++level)
+    {
+        keys.clear();
+        collectKeys(map, level, keys);
+        total += keys.size();
+    }
+    return total;
+}
+
+Status
+TileSeeder::run(const Map* map, const IOOptions& io)
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(map, Status(Status::AssertionFailure));
+
+    if (!map->profile().valid())
+        return Status(Status::ConfigurationError, "Map has no valid profile");
+
+    if (minLevel > maxLevel)
+        return Status(Status::ConfigurationError, "minLevel is greater than maxLevel");
+
+    auto seed_layers = layersToSeed(map);
+    if (seed_layers.empty())
+        return Status(Status::ConfigurationError, "No open image or elevation layers to seed");
+
+    if ((!io.services.cache || !io.services.cache()) && !onTile)
+    {
+        Log()->warn(LC "No cache is configured; tiles will be created but not stored");
+    }
+
+    Progress progress;
+    progress.total = count(map);
+
+    const std::string sig = signature(map, seed_layers);
+    std::size_t resume_at = 0;
+    if (!checkpoint.empty() && readCheckpoint(checkpoint, sig, resume_at))
+    {
+        Log()->info(LC "Resuming from key " + std::to_string(resume_at) + " of " + std::to_string(progress.total));
+    }
+
+    const unsigned threads = std::max(1u, concurrency);
+    auto pool = jobs::get_pool("rocky.seed");
+    pool->set_concurrency(threads);
+
+    std::atomic<std::size_t> created = { 0 };
+    std::atomic<std::size_t> failed = { 0 };
+
+    auto seed = [&](const TileKey& key)
+    {
+        for (auto& layer : seed_layers)
+        {
+            if (io.canceled())
+                return;
+
+            if (!layer->isKeyInLegalRange(key) || !layer->intersects(key) || !layer->mayHaveData(key))
+                continue;
+
+            shared_ptr<Image> tile;
+            Status status;
+
+            if (auto image_layer = dynamic_cast<const ImageLayer*>(layer.get()))
+            {
+                auto r = image_layer->createImage(key, io);
+                status = r.status;
+                if (r.status.ok() && r.value.valid())
+                    tile = r.value.image();
+            }
+            else if (auto elevation_layer = dynamic_cast<const ElevationLayer*>(layer.get()))
+            {
+                auto r = elevation_layer->createHeightfield(key, io);
+                status = r.status;
+                if (r.status.ok() && r.value.valid())
+                    tile = r.value.heightfield();
+            }
+
+            if (status.failed())
+            {
+                ++failed;
+            }
+            else if (tile)
+            {
+                ++created;
+                if (onTile)
+                    onTile(layer.get(), key, tile);
+            }
+        }
+    };
+
+    std::size_t index = 0; // global position in the visiting order
+    std::vector<TileKey> keys;
+    bool canceled = false;
+
+    for (unsigned level = minLevel; level <= maxLevel && !canceled; ++level)
+    {
+        keys.clear();
+        collectKeys(map, level, keys);
+        progress.level = level;
+
+        // skip whatever a previous run already finished:
+        std::size_t first = 0;
+        if (index + keys.size() <= resume_at)
+            first = keys.size();
+        else if (index < resume_at)
+            first = resume_at - index;
+
+        progress.resumed += first;
+        progress.completed += first;
+
+        const std::size_t batch_size = (std::size_t)threads * keys_per_batch_per_thread;
+
+        for (std::size_t b = first; b < keys.size(); b += batch_size)
+        {
+            if (io.canceled())
+            {
+                canceled = true;
+                break;
+            }
+
+            std::size_t end = std::min(b + batch_size, keys.size());
+
+            auto group = jobs::jobgroup::create();
+            jobs::context con{ "seed " + std::to_string(level), pool, {}, group };
+
+            for (std::size_t i = b; i < end; ++i)
+            {
+                jobs::dispatch([&seed, &keys, i]()
+                    {
+                        seed(keys[i]);
+                    }, con);
+            }
+
+            // Always join: the jobs refer to our locals.
+            group->join();
+
+            if (io.canceled())
+            {
+                canceled = true;
+                break;
+            }
+
+            progress.completed += (end - b);
+            progress.created = created;
+            progress.failed = failed;
+
+            if (!checkpoint.empty())
+            {
+                if (onCheckpoint)
+                    onCheckpoint();
+
+                writeCheckpoint(checkpoint, sig, index + end);
+            }
+
+            if (onProgress && !onProgress(progress))
+            {
+                canceled = true;
+                break;
+            }
+        }
+
+        index += keys.size();
+    }
+
+    progress.created = created;
+    progress.failed = failed;
+
+    if (canceled)
+        return Status(Status::GeneralError, "Seeding canceled");
+
+    // finished, so there's nothing left to resume:
+    if (!checkpoint.empty())
+        std::remove(checkpoint.c_str());
+
+    if (onProgress)
+        onProgress(progress);
+
+    return StatusOK;
+}
@@ -0,0 +1,118 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#pragma once
+
+#include <rocky/Common.h>
+#include <rocky/GeoExtent.h>
+#include <rocky/IOTypes.h>
+#include <rocky/Status.h>
+#include <rocky/TileKey.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ROCKY_NAMESPACE
+{
+    class Feature;
+    class Image;
+    class Map;
+    class TileLayer;
+
+    /**
+     * Pre-generates the tiles of a map's image and elevation layers over
+     * an area and range of levels, so that an application can later run
+     * from the cache without a network connection.
+     *
+     * Tiles are created with the layers' own createImage/createHeightfield
+     * calls, so they land in whatever Cache the IOOptions supply (e.g. a
+     * DiskCache). Use onTile to also export each tile elsewhere, e.g. to
+     * an MBTiles database, and onCheckpoint to commit what onTile buffers.
+     *
+     * Usage:
+     *   TileSeeder seeder;
+     *   seeder.extent = GeoExtent(SRS::WGS84, -78, 38, -76, 40);
+     *   seeder.minLevel = 0;
+     *   seeder.maxLevel = 12;
+     *   seeder.checkpoint = "seed.checkpoint";
+     *   auto status = seeder.run(map.get(), instance.ioOptions());
+     */
+    class ROCKY_EXPORT TileSeeder
+    {
+    public:
+        //! Progress of a seeding run
+        struct Progress
+        {
+            std::size_t total = 0;      // tile keys to visit
+            std::size_t completed = 0;  // tile keys visited so far (including resumed ones)
+            std::size_t resumed = 0;    // tile keys skipped thanks to the checkpoint
+            std::size_t created = 0;    // layer tiles created
+            std::size_t failed = 0;     // layer tiles that reported an error
+            unsigned level = 0;         // level currently being seeded
+        };
+
+        //! Progress function; return false to stop the run.
+        using ProgressCallback = std::function<bool(const Progress&)>;
+
+        //! Called for each tile created; may be called from several threads at once.
+        using TileCallback = std::function<void(const TileLayer*, const TileKey&, shared_ptr<Image>)>;
+
+        //! Area to seed, in any SRS. An invalid extent means the whole profile
+        //! (or the extent of the area feature, if there is one).
+        GeoExtent extent;
+
+        //! Optional polygon or multipolygon feature to seed inside of. Only tiles
+        //! that touch it are seeded. The feature's extent must be set.
+        shared_ptr<Feature> area;
+
+        //! First level of detail to seed
+        unsigned minLevel = 0;
+
+        //! Last level of detail to seed (inclusive)
+        unsigned maxLevel = 0;
+
+        //! Layers to seed. If empty, seed all the map's image and elevation layers.
+        std::vector<shared_ptr<TileLayer>> layers;
+
+        //! Number of tile keys to process at the same time
+        unsigned concurrency = 8;
+
+        //! Optional file recording how far the run got, so that a later run
+        //! with the same settings can pick up where this one left off.
+        //! It is removed when a run completes.
+        std::string checkpoint;
+
+        //! Optional progress reporter, called periodically from the
+        //! thread calling run().
+        ProgressCallback onProgress;
+
+        //! Optional sink for each tile created
+        TileCallback onTile;
+
+        //! Optional function called from the thread calling run() right before
+        //! each checkpoint is written. If onTile buffers its writes, commit them
+        //! here so the checkpoint never gets ahead of the stored tiles.
+        std::function<void()> onCheckpoint;
+
+    public:
+        //! Seeds the tiles.
+        //! @param map Map whose profile defines the tiling and whose layers to seed
+        //! @param io IO options; these must supply the cache to populate
+        //!   unless you use onTile to store the tiles yourself
+        //! @return Status; an error if io was canceled or onProgress returned false
+        Status run(const Map* map, const IOOptions& io);
+
+        //! Number of tile keys that run() would visit.
+        std::size_t count(const Map* map) const;
+
+        //! Appends the keys in the seed area at one level, in the order
+        //! run() visits them.
+        void collectKeys(const Map* map, unsigned level, std::vector<TileKey>& out_keys) const;
+
+    private:
+        std::vector<shared_ptr<TileLayer>> layersToSeed(const Map* map) const;
+        std::string signature(const Map* map, const std::vector<shared_ptr<TileLayer>>& layers) const;
+    };
+}
@@ -6,10 +6,14 @@
 #include "URI.h"
 #include "Utils.h"
 #include "Instance.h"
+#include "Threading.h"
 #include <typeinfo>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
 
 #ifdef ROCKY_HAS_HTTPLIB
 #ifdef ROCKY_HAS_OPENSSL
@@ -40,6 +44,9 @@ namespace
 {
     static bool httpDebug = ::getenv("ROCKY_HTTP_DEBUG") != nullptr;
 
+    // network reads currently in progress
+    static util::Coalescer<std::string, Result<Content>> inflight_reads;
+
     bool containsServerAddress(const std::string& input)
     {
         auto temp = util::trim(util::toLower(input));
@@ -119,7 +126,189 @@ namespace
         return true;
     }
 
-    IOResult<HTTPResponse> http_get(const HTTPRequest& request, unsigned max_attempts)
+#ifdef ROCKY_HAS_HTTPLIB
+    /**
+    * Keeps idle keep-alive connections around, per server, so requests
+    * can skip the TCP and TLS handshakes, and caps the number of
+    * simultaneous connections to each server. It also tracks a shared
+    * backoff time per server so that when a server stops responding,
+    * every request to it backs off instead of each one hammering it.
+    */
+    class ConnectionPool
+    {
+    private:
+        struct Host;
+
+    public:
+        using Client = std::unique_ptr<httplib::Client>;
+
+        //! A connection checked out of the pool. It goes back to the pool
+        //! when released, or is discarded (freeing its slot) if the lease
+        //! is destroyed first, e.g. by an exception.
+        class Lease
+        {
+        public:
+            Lease() = default;
+            Lease(Lease&& rhs) : _host(std::exchange(rhs._host, nullptr)), _client(std::move(rhs._client)) { }
+            Lease& operator=(Lease&&) = delete;
+            Lease(const Lease&) = delete;
+            ~Lease() { release(false); }
+
+            explicit operator bool() const { return _client != nullptr; }
+            httplib::Client* operator->() const { return _client.get(); }
+
+            //! Returns the connection to the pool. If the connection failed,
+            //! pass reusable=false and it will be discarded.
+            void release(bool reusable)
+            {
+                if (_host)
+                    ConnectionPool::release(*std::exchange(_host, nullptr), std::move(_client), reusable);
+            }
+
+        private:
+            Lease(Host* host, Client client) : _host(host), _client(std::move(client)) { }
+            Host* _host = nullptr;
+            Client _client;
+            friend class ConnectionPool;
+        };
+
+        //! Gets a connection to a server, waiting for one to become available
+        //! if the server is already at its connection limit. Returns an empty
+        //! lease if the operation is canceled while waiting.
+        Lease acquire(const std::string& proto_host_port, const IOOptions& io)
+        {
+            auto& host = get(proto_host_port);
+
+            std::unique_lock<std::mutex> lock(host.mutex);
+
+            while (host.active >= std::max(1u, io.maxConnectionsPerHost))
+            {
+                if (io.canceled())
+                    return {};
+
+                host.released.wait_for(lock, 100ms);
+            }
+
+            ++host.active;
+
+            if (!host.idle.empty())
+            {
+                auto client = std::move(host.idle.back());
+                host.idle.pop_back();
+                return Lease(&host, std::move(client));
+            }
+
+            lock.unlock();
+
+            // from here on the lease owns the slot, even if creating the client throws
+            Lease lease(&host, nullptr);
+
+            lease._client = std::make_unique<httplib::Client>(proto_host_port);
+
+            // follow redirects
+            lease._client->set_follow_location(true);
+
+            // disable cert verification
+            lease._client->enable_server_certificate_verification(false);
+
+            // reuse the connection for subsequent requests
+            lease._client->set_keep_alive(true);
+
+            return lease;
+        }
+
+        //! Records a connection failure; returns the time before which
+        //! the server should not be contacted again.
+        std::chrono::steady_clock::time_point fail(const std::string& proto_host_port)
+        {
+            auto& host = get(proto_host_port);
+            std::lock_guard<std::mutex> lock(host.mutex);
+            auto now = std::chrono::steady_clock::now();
+            if (host.retry_after <= now)
+            {
+                // exponential backoff: 250ms, 500ms, 1s ... 8s
+                auto delay = 250ms * (1 << std::min(host.failures, 5u));
+                host.retry_after = now + delay;
+                ++host.failures;
+            }
+            return host.retry_after;
+        }
+
+        //! Records a successful request, resetting the backoff
+        void succeed(const std::string& proto_host_port)
+        {
+            auto& host = get(proto_host_port);
+            std::lock_guard<std::mutex> lock(host.mutex);
+            host.failures = 0;
+        }
+
+        //! Time before which the server should not be contacted
+        std::chrono::steady_clock::time_point retryAfter(const std::string& proto_host_port)
+        {
+            auto& host = get(proto_host_port);
+            std::lock_guard<std::mutex> lock(host.mutex);
+            return host.retry_after;
+        }
+
+    private:
+        static void release(Host& host, Client client, bool reusable)
+        {
+            {
+                std::lock_guard<std::mutex> lock(host.mutex);
+                --host.active;
+                if (client && reusable)
+                    host.idle.emplace_back(std::move(client));
+            }
+            host.released.notify_one();
+        }
+
+        struct Host
+        {
+            std::mutex mutex;
+            std::condition_variable released;
+            std::vector<Client> idle;
+            unsigned active = 0;
+            unsigned failures = 0;
+            std::chrono::steady_clock::time_point retry_after;
+        };
+
+        std::mutex _mutex;
+        std::unordered_map<std::string, std::unique_ptr<Host>> _hosts;
+
+        Host& get(const std::string& proto_host_port)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto& host = _hosts[proto_host_port];
+            if (!host)
+                host = std::make_unique<Host>();
+            return *host;
+        }
+    };
+
+    ConnectionPool& connectionPool()
+    {
+        static ConnectionPool pool;
+        return pool;
+    }
+
+    // Waits until "until" unless the operation is canceled first.
+    // Returns false if canceled.
+    bool wait_until(std::chrono::steady_clock::time_point until, const IOOptions& io)
+    {
+        while (std::chrono::steady_clock::now() < until)
+        {
+            if (io.canceled())
+                return false;
+
+            std::this_thread::sleep_for(std::min(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(50ms),
+                until - std::chrono::steady_clock::now()));
+        }
+        return !io.canceled();
+    }
+#endif
+
+    IOResult<HTTPResponse> http_get(const HTTPRequest& request, const IOOptions& io)
     {
 #ifndef ROCKY_HAS_HTTPLIB
         return Status(Status::ServiceUnavailable);
@@ -142,22 +331,24 @@ namespace
 
         HTTPResponse response;
 
+        auto& pool = connectionPool();
+
         try
         {
-            httplib::Client client(proto_host_port);
-
-            // follow redirects
-            client.set_follow_location(true);
-
-            // disable cert verification
-            client.enable_server_certificate_verification(false);
-
-            max_attempts = std::max(1u, max_attempts);
+            unsigned max_attempts = std::max(1u, io.maxNetworkAttempts);
 
             for(;;)
             {
+                // if the server is backing off, wait it out (or give up if canceled)
+                if (!wait_until(pool.retryAfter(proto_host_port), io))
+                    return Status(Status::ResourceUnavailable, "Canceled");
+
+                auto client = pool.acquire(proto_host_port, io);
+                if (!client)
+                    return Status(Status::ResourceUnavailable, "Canceled");
+
                 auto t0 = std::chrono::steady_clock::now();
-                auto r = client.Get(path, params, headers);
+                auto r = client->Get(path, params, headers);
                 auto t1 = std::chrono::steady_clock::now();
 
                 if (httpDebug && r == true)
@@ -172,19 +363,25 @@ namespace
                         + ct + ")");
                 }
 
-                if (r.error() != httplib::Error::Success)
+                // a failed connection cannot be reused
+                bool ok = (r.error() == httplib::Error::Success);
+                client.release(ok);
+
+                if (!ok)
                 {
                     // retry on a missing connection
                     if (r.error() == httplib::Error::Connection && (--max_attempts > 0))
                     {
                         Log()->info(LC + httplib::to_string(r.error()) + " with " + proto_host_port + "; retrying..");
-                        std::this_thread::sleep_for(1s);
+                        pool.fail(proto_host_port);
                         continue;
                     }
 
                     return Status(Status::ServiceUnavailable, httplib::to_string(r.error()));
                 }
 
+                pool.succeed(proto_host_port);
+
                 if (r->status == 404)
                 {
                     return Status(Status::ResourceUnavailable, httplib::status_message(r->status));
@@ -308,9 +505,12 @@ URI::read(const IOOptions& io) const
     {
         if (httpDebug)
         {
+            auto m = io.services.contentCache->metrics();
             Log()->info(LC "Cache hit, ratio = "
-                + std::to_string(100.0f * (float)io.services.contentCache->hits / (float)io.services.contentCache->gets)
-                + "%");
+                + std::to_string(100.0f * (float)m.hits / (float)m.gets)
+                + "%, " + std::to_string(m.entries) + " entries, "
+                + std::to_string(m.size / 1024) + "/" + std::to_string(m.capacity / 1024) + " KB, "
+                + std::to_string(m.evictions) + " evictions");
         }
 
         return cached.value;
@@ -334,28 +534,48 @@ URI::read(const IOOptions& io) const
 
     else if (containsServerAddress(full()))
     {
-        HTTPRequest request{ full() };
-        auto r = http_get(request, io.maxNetworkAttempts);
-        if (r.status.failed())
-        {
-            return IOResult<Content>::propagate(r);
-        }
+        // Concurrent reads of the same URL share a single request.
+        auto r = inflight_reads.run(full(), [&]() -> Result<Content>
+            {
+                // another thread may have just finished reading it:
+                auto cached = io.services.contentCache->get(full());
+                if (cached.status.ok())
+                    return cached.value;
+
+                HTTPRequest request{ full() };
+                auto r = http_get(request, io);
+                if (r.status.failed())
+                {
+                    return r.status;
+                }
 
-        std::string contentType;
+                std::string contentType;
 
-        auto i = r.value.headers.find("Content-Type");
-        if (i != r.value.headers.end())
-            contentType = i->second;
-        else
-            contentType = inferContentTypeFromFileExtension(full());
+                auto i = r.value.headers.find("Content-Type");
+                if (i != r.value.headers.end())
+                    contentType = i->second;
+                else
+                    contentType = inferContentTypeFromFileExtension(full());
 
-        if (contentType.empty())
-            contentType = inferContentTypeFromData(r.value.data);
+                if (contentType.empty())
+                    contentType = inferContentTypeFromData(r.value.data);
 
-        content = {
-            contentType,
-            r.value.data
-        };
+                Content content{
+                    contentType,
+                    std::move(r.value.data)
+                };
+
+                io.services.contentCache->put(full(), Result<Content>(content));
+
+                return content;
+            }, &io);
+
+        if (r.status.failed())
+        {
+            return IOResult<Content>(r.status);
+        }
+
+        return r.value;
     }
     else
     {
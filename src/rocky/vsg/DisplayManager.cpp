@@ -217,6 +217,40 @@ DisplayManager::addWindow(vsg::ref_ptr<vsg::WindowTraits> traits)
 
     auto window = vsg::Window::create(traits);
 
+    // The first window creates the device. Before it does, find the physical
+    // device it will pick, and enable the optional features it supports.
+    if (!traits->device)
+    {
+        auto instance = window->getOrCreateInstance();
+        auto surface = window->getOrCreateSurface();
+        auto [physicalDevice, graphicsFamily, presentFamily] = instance->getPhysicalDeviceAndQueueFamily(
+            VK_QUEUE_GRAPHICS_BIT, surface, traits->deviceTypePreferences);
+
+        if (physicalDevice)
+        {
+            auto& supported = physicalDevice->getFeatures();
+            auto& enabled = traits->deviceFeatures->get();
+
+            enabled.textureCompressionBC = supported.textureCompressionBC;
+            enabled.shaderSampledImageArrayDynamicIndexing = supported.shaderSampledImageArrayDynamicIndexing;
+
+            if (app)
+            {
+                auto& features = app->instance.runtime().deviceFeatures;
+                features.textureCompressionBC = (supported.textureCompressionBC == VK_TRUE);
+                features.shaderSampledImageArrayDynamicIndexing = (supported.shaderSampledImageArrayDynamicIndexing == VK_TRUE);
+
+                auto& limits = physicalDevice->getProperties().limits;
+                auto& deviceLimits = app->instance.runtime().deviceLimits;
+                deviceLimits.maxPerStageDescriptorSamplers = limits.maxPerStageDescriptorSamplers;
+                deviceLimits.maxPerStageDescriptorSampledImages = limits.maxPerStageDescriptorSampledImages;
+                deviceLimits.maxPerStageResources = limits.maxPerStageResources;
+                deviceLimits.maxDescriptorSetSamplers = limits.maxDescriptorSetSamplers;
+                deviceLimits.maxDescriptorSetSampledImages = limits.maxDescriptorSetSampledImages;
+            }
+        }
+    }
+
     addWindow(window);
 
     return window;
@@ -62,8 +62,10 @@ namespace
     };
 
     // recursive search for a vsg::ReaderWriters that matches the extension
+    // and supports the requested feature (READ_ISTREAM by default)
     // TODO: expand to include 'protocols' I guess
-    vsg::ref_ptr<vsg::ReaderWriter> findReaderWriter(const std::string& extension, const vsg::ReaderWriters& readerWriters)
+    vsg::ref_ptr<vsg::ReaderWriter> findReaderWriter(const std::string& extension, const vsg::ReaderWriters& readerWriters,
+        vsg::ReaderWriter::FeatureMask feature = vsg::ReaderWriter::FeatureMask::READ_ISTREAM)
     {
         vsg::ref_ptr<vsg::ReaderWriter> output;
 
@@ -73,7 +75,7 @@ namespace
             auto crw = dynamic_cast<vsg::CompositeReaderWriter*>(rw.get());
             if (crw)
             {
-                output = findReaderWriter(extension, crw->readerWriters);
+                output = findReaderWriter(extension, crw->readerWriters, feature);
             }
             else if (rw->getFeatures(features))
             {
@@ -81,7 +83,7 @@ namespace
 
                 if (j != features.extensionFeatureMap.end())
                 {
-                    if (j->second & vsg::ReaderWriter::FeatureMask::READ_ISTREAM)
+                    if (j->second & feature)
                     {
                         output = rw;
                     }
@@ -328,6 +330,34 @@ InstanceVSG::InstanceVSG() :
         }
         return Status(Status::ServiceUnavailable, "No image reader for \"" + contentType + "\"");
     };
+
+    // Likewise for writing; fall back on the core encoder (if any) when
+    // no VSG writer supports the format.
+    auto fallbackWriter = ioOptions().services.writeImageToStream;
+
+    ioOptions().services.writeImageToStream = [readerWriterOptions, fallbackWriter](
+        shared_ptr<Image> image, std::ostream& out, std::string contentType, const rocky::IOOptions& io)
+        -> Status
+    {
+        auto i = ext_for_mime_type.find(contentType);
+        if (i != ext_for_mime_type.end())
+        {
+            auto rw = findReaderWriter(i->second, readerWriterOptions->readerWriters, vsg::ReaderWriter::FeatureMask::WRITE_OSTREAM);
+            if (rw != nullptr)
+            {
+                auto local_options = vsg::Options::create(*readerWriterOptions);
+                local_options->extensionHint = i->second;
+                auto data = util::shareImageWithVSG(image);
+                if (data && rw->write(data, out, local_options))
+                    return StatusOK;
+            }
+        }
+
+        if (fallbackWriter)
+            return fallbackWriter(image, out, contentType, io);
+
+        return Status(Status::ServiceUnavailable, "No image writer for \"" + contentType + "\"");
+    };
 }
 
 InstanceVSG::InstanceVSG(vsg::CommandLine& args) :
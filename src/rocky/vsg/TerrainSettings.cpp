@@ -29,6 +29,8 @@ TerrainSettings::TerrainSettings(const JSON& conf)
     get_to(j, "normalize_edges", normalizeEdges);
     get_to(j, "morph_terrain", morphTerrain);
     get_to(j, "morph_imagery", morphImagery);
+    get_to(j, "compress_textures", compressTextures);
+    get_to(j, "bindless", bindless);
     get_to(j, "concurrency", concurrency);
 }
 
@@ -53,6 +55,8 @@ TerrainSettings::to_json() const
     set(j, "normalize_edges", normalizeEdges);
     set(j, "morph_terrain", morphTerrain);
     set(j, "morph_imagery", morphImagery);
+    set(j, "compress_textures", compressTextures);
+    set(j, "bindless", bindless);
     set(j, "concurrency", concurrency);
     return j.dump();
 }
@@ -80,8 +80,9 @@ namespace ROCKY_NAMESPACE
         //! Whether to generate normal map textures. Default is true
         optional<bool> useNormalMaps = true;
 
-        //! Whether to average normal vectors on tile boundaries. Doing so reduces the
-        //! the appearance of seams when using lighting, but requires extra CPU work.
+        //! Whether to average elevation (and therefore normal vectors) on tile boundaries
+        //! with the neighboring tiles. Doing so reduces the appearance of cracks and of
+        //! seams when using lighting, but requires extra CPU work in the loader threads.
         optional<bool> normalizeEdges = false;
 
         //! Whether to morph terrain data between terrain tile LODs.
@@ -92,6 +93,21 @@ namespace ROCKY_NAMESPACE
         //! This feature is not available when using screen-space error LOD
         optional<bool> morphImagery = false;
 
+        //! Whether to block-compress terrain imagery (BC1, or BC3 for imagery with
+        //! transparency) before uploading it. This uses 4 to 8 times less GPU memory
+        //! and bandwidth per tile, at the cost of some image quality and of CPU time
+        //! in the loader threads. Ignored when the device does not support BC texture
+        //! compression.
+        optional<bool> compressTextures = false;
+
+        //! Whether to render all terrain tiles with a single descriptor set that
+        //! holds arrays of every tile's textures, instead of binding a descriptor
+        //! set per tile. Saves a descriptor set and its binding per tile, and tiles
+        //! sharing a parent's image share its texture. Requires a device that
+        //! supports dynamic indexing of sampler arrays and can bind about 12,000
+        //! textures in one descriptor set; ignored otherwise.
+        optional<bool> bindless = false;
+
         //! Target concurrency of terrain data loading operations.
         optional<unsigned> concurrency = 4;
 
@@ -192,11 +192,17 @@ BindIconStyle::init(vsg::ref_ptr<vsg::PipelineLayout> layout)
 
     if (image)
     {
+        // Icons are usually drawn smaller than their images, so
+        // mipmap them to avoid sparkling at a distance.
+        auto mipmapped = image->generateMipmaps();
+        if (mipmapped)
+            image = mipmapped;
+
         auto tex_data = util::moveImageToVSG(image);
 
         // A sampler for the texture:
         auto sampler = vsg::Sampler::create();
-        sampler->maxLod = 5; // this alone will prompt mipmap generation!
+        sampler->maxLod = VK_LOD_CLAMP_NONE; // use all the mipmaps
         sampler->minFilter = VK_FILTER_LINEAR;
         sampler->magFilter = VK_FILTER_LINEAR;
         sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
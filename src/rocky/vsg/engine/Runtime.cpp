@@ -8,7 +8,10 @@
 #include <vsg/app/Viewer.h>
 #include <vsg/text/Font.h>
 #include <vsg/io/read.h>
+#include <vsg/core/Objects.h>
 #include <shared_mutex>
+#include <algorithm>
+#include <limits>
 
 using namespace ROCKY_NAMESPACE;
 
@@ -17,10 +20,10 @@ namespace
     /**
     * An update operation that maintains a priroity queue for update tasks.
     * This sits in the VSG viewer's update operations queue indefinitely
-    * and runs once per frame. It chooses the highest priority task in its
-    * queue and runs it. It will run one task per frame so that we do not
-    * risk frame drops. It will automatically discard any tasks that have
-    * been abandoned (no Future exists).
+    * and runs once per frame. It runs the highest priority tasks in its
+    * queue until it exhausts its time budget, always running at least one
+    * task per frame so that the queue keeps moving. It will automatically
+    * discard any tasks that have been abandoned (no Future exists).
     */
     struct PriorityUpdateQueue : public vsg::Inherit<vsg::Operation, PriorityUpdateQueue>
     {
@@ -29,35 +32,66 @@ namespace
         struct Task {
             vsg::ref_ptr<vsg::Operation> function;
             std::function<float()> get_priority;
+            float priority = 0.0f;
+
+            // max-heap ordering on the cached priority
+            bool operator < (const Task& rhs) const {
+                return priority < rhs.priority;
+            }
         };
-        std::vector<Task> _queue;
+        std::vector<Task> _queue; // binary heap
+
+        Runtime& _runtime;
+
+        PriorityUpdateQueue(Runtime& runtime) :
+            _runtime(runtime) { }
+
+        // tasks without a priority function go first.
+        static float evaluate(const Task& task) {
+            return task.get_priority ? task.get_priority() : std::numeric_limits<float>::max();
+        }
+
+        // called with the mutex locked.
+        void push(Task&& task)
+        {
+            _queue.emplace_back(std::move(task));
+            std::push_heap(_queue.begin(), _queue.end());
+        }
 
-        // runs one task per frame.
+        // runs tasks until the budget runs out.
         void run() override
         {
-            if (!_queue.empty())
+            auto start = std::chrono::steady_clock::now();
+            auto deadline = start + _runtime.updateBudget;
+            Runtime::UpdateStats stats;
+
+            {
+                std::scoped_lock lock(_mutex);
+                stats.queued = _queue.size();
+
+                // Priorities change from frame to frame (e.g., as the camera moves),
+                // so re-evaluate each one once and rebuild the heap. This is linear,
+                // unlike a full sort that calls the priority functions O(n log n) times.
+                if (_queue.size() > 1)
+                {
+                    for (auto& task : _queue)
+                        task.priority = evaluate(task);
+
+                    std::make_heap(_queue.begin(), _queue.end());
+                }
+            }
+
+            while (true)
             {
                 Task task;
                 {
                     std::scoped_lock lock(_mutex);
 
-                    // sort from low to high priority
-                    std::sort(_queue.begin(), _queue.end(),
-                        [](const Task& lhs, const Task& rhs)
-                        {
-                            if (lhs.get_priority == nullptr)
-                                return false;
-                            else if (rhs.get_priority == nullptr)
-                                return true;
-                            else
-                                return lhs.get_priority() < rhs.get_priority();
-                        }
-                    );
-
                     while (!_queue.empty())
                     {
-                        // pop the highest priority off the back.
-                        task = _queue.back();
+                        // pop the highest priority task off the heap.
+                        std::pop_heap(_queue.begin(), _queue.end());
+                        task = std::move(_queue.back());
                         _queue.pop_back();
 
                         // check for cancelation - if the task is already canceled, 
@@ -65,16 +99,33 @@ namespace
                         auto po = dynamic_cast<Cancelable*>(task.function.get());
                         if (po == nullptr || !po->canceled())
                             break;
-                        else
-                            task = { };
+
+                        task = { };
+                        stats.canceled++;
                     }
                 }
 
-                if (task.function)
-                {
-                    task.function->run();
-                }
+                if (!task.function)
+                    break;
+
+                auto task_start = std::chrono::steady_clock::now();
+                task.function->run();
+                auto now = std::chrono::steady_clock::now();
+
+                stats.tasks++;
+                stats.longestTask = std::max(stats.longestTask,
+                    std::chrono::duration_cast<std::chrono::microseconds>(now - task_start));
+
+                if (now >= deadline)
+                    break;
             }
+
+            stats.total = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            {
+                std::scoped_lock lock(_mutex);
+                stats.remaining = _queue.size();
+            }
+            _runtime.updateStats = stats;
         }
     };
 
@@ -119,7 +170,7 @@ Runtime::Runtime()
 
     shaderCompileSettings = vsg::ShaderCompileSettings::create();
 
-    _priorityUpdateQueue = PriorityUpdateQueue::create();
+    _priorityUpdateQueue = PriorityUpdateQueue::create(*this);
 
     // initialize the deferred deletion collection.
     // a large number of frames ensures objects will be safely destroyed and
@@ -133,6 +184,10 @@ Runtime::runDuringUpdate(vsg::ref_ptr<vsg::Operation> function, std::function<fl
     auto pq = dynamic_cast<PriorityUpdateQueue*>(_priorityUpdateQueue.get());
     if (pq)
     {
+        // evaluate the initial priority outside the lock
+        PriorityUpdateQueue::Task task{ function, get_priority };
+        task.priority = PriorityUpdateQueue::evaluate(task);
+
         std::scoped_lock lock(pq->_mutex);
 
         if (pq->referenceCount() == 1)
@@ -140,7 +195,7 @@ Runtime::runDuringUpdate(vsg::ref_ptr<vsg::Operation> function, std::function<fl
             viewer->updateOperations->add(_priorityUpdateQueue, vsg::UpdateOperations::ALL_FRAMES);
         }
 
-        pq->_queue.push_back({ function, get_priority });
+        pq->push(std::move(task));
     }
 }
 
@@ -172,6 +227,58 @@ Runtime::compile(vsg::ref_ptr<vsg::Object> compilable)
     }
 }
 
+void
+Runtime::compileInBatch(vsg::ref_ptr<vsg::Object> object, std::function<void()> then)
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(object.valid(), void());
+
+    std::scoped_lock lock(_batchMutex);
+
+    if (!_batch)
+        _batch = vsg::Objects::create();
+
+    _batch->addChild(object);
+
+    if (then)
+        _batchCallbacks.emplace_back(then);
+}
+
+void
+Runtime::compileBatch()
+{
+    vsg::ref_ptr<vsg::Objects> batch;
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::scoped_lock lock(_batchMutex);
+        batch.swap(_batch);
+        callbacks.swap(_batchCallbacks);
+    }
+
+    if (batch)
+    {
+        ROCKY_PROFILE_FUNCTION();
+
+        if (!asyncCompile)
+        {
+            // same rule as the deferred path in update()
+            viewer->deviceWaitIdle();
+        }
+
+        // One compile traversal for the whole batch: vsg collects all the
+        // dynamic data into a single transfer task.
+        auto cr = viewer->compileManager->compile(batch);
+        if (cr && cr.requiresViewerUpdate())
+        {
+            vsg::updateViewer(*viewer, cr);
+        }
+
+        for (auto& callback : callbacks)
+        {
+            callback();
+        }
+    }
+}
+
 void
 Runtime::dispose(vsg::ref_ptr<vsg::Object> object)
 {
@@ -195,6 +302,9 @@ Runtime::dispose(vsg::ref_ptr<vsg::Object> object)
 void
 Runtime::update()
 {
+    // compile everything that was queued by the update operations this frame
+    compileBatch();
+
     if (asyncCompile)
     {
         if (_compileResults.size() > 0)
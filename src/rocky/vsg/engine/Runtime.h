@@ -18,6 +18,7 @@
 #include <vsg/text/Font.h>
 #include <shared_mutex>
 #include <queue>
+#include <chrono>
 
 namespace vsg
 {
@@ -67,6 +68,43 @@ namespace ROCKY_NAMESPACE
         //! until the next call to update().
         bool asyncCompile = true;
 
+        //! Maximum time to spend running prioritized update tasks (see runDuringUpdate)
+        //! during each frame. At least one task runs per frame regardless.
+        std::chrono::microseconds updateBudget{ 2000 };
+
+        //! Statistics from the most recent run of the prioritized update tasks
+        struct UpdateStats
+        {
+            std::size_t queued = 0; // tasks in the queue at the start of the frame
+            std::size_t remaining = 0; // tasks left in the queue at the end of the frame
+            std::size_t tasks = 0; // tasks run this frame
+            std::size_t canceled = 0; // canceled tasks discarded this frame
+            std::chrono::microseconds longestTask{ 0 }; // slowest single task this frame
+            std::chrono::microseconds total{ 0 }; // total time spent this frame
+        };
+        UpdateStats updateStats;
+
+        //! Optional Vulkan features enabled on the device. DisplayManager enables
+        //! them when the hardware supports them and records it here; they stay
+        //! false for devices created by other means.
+        struct DeviceFeatures
+        {
+            bool textureCompressionBC = false; // BC1-BC7 textures
+            bool shaderSampledImageArrayDynamicIndexing = false; // texture arrays indexed by non-constants
+        };
+        DeviceFeatures deviceFeatures;
+
+        //! Limits of the device (set by the DisplayManager; zero if unknown)
+        struct DeviceLimits
+        {
+            uint32_t maxPerStageDescriptorSamplers = 0;
+            uint32_t maxPerStageDescriptorSampledImages = 0;
+            uint32_t maxPerStageResources = 0;
+            uint32_t maxDescriptorSetSamplers = 0;
+            uint32_t maxDescriptorSetSampledImages = 0;
+        };
+        DeviceLimits deviceLimits;
+
         //! Custom vsg object disposer (optional)
         //! By default Runtime uses its own round-robin object disposer
         std::function<void(vsg::ref_ptr<vsg::Object>)> disposer;
@@ -90,6 +128,18 @@ namespace ROCKY_NAMESPACE
         //! Be careful to only call this from a safe thread
         void compile(vsg::ref_ptr<vsg::Object> object);
 
+        //! Queues an object for compilation at the end of the current update pass.
+        //! Everything queued during a frame compiles in a single traversal, so the
+        //! uploads share one staging buffer and one transfer submission instead of
+        //! paying the per-compile overhead for each object.
+        //! Only call this from the update pass (e.g. a runDuringUpdate task).
+        //! The batch compiles in update(), so the host must call that every frame.
+        //! @param object Object to compile
+        //! @param then Optional function to call after the batch compiles
+        void compileInBatch(
+            vsg::ref_ptr<vsg::Object> object,
+            std::function<void()> then = {});
+
         //! Destroys a VSG object, eventually. 
         //! Call this to get rid of descriptor sets you plan to replace.
         //! You can't just let them go since they recycle internally and 
@@ -122,7 +172,11 @@ namespace ROCKY_NAMESPACE
             shaderSettingsRevision++;
         }
 
-        //! Update any pending compile results.
+        //! Compiles the batch queued by compileInBatch, integrates any pending
+        //! compile results, and advances the disposal queue.
+        //! Every host must call this once per frame, right after viewer->update()
+        //! (Application::frame does it for you); otherwise batched objects are
+        //! never compiled and disposed objects are never released.
         void update();
 
     private:
@@ -134,6 +188,13 @@ namespace ROCKY_NAMESPACE
         std::queue<vsg::ref_ptr<vsg::Object>> _toCompile;
         std::vector<vsg::CompileResult> _compileResults;
 
+        // objects queued by compileInBatch
+        std::mutex _batchMutex;
+        vsg::ref_ptr<vsg::Objects> _batch;
+        std::vector<std::function<void()>> _batchCallbacks;
+
+        void compileBatch();
+
         // deferred deletion container
         mutable std::shared_mutex _deferred_unref_mutex;
         std::list<std::vector<vsg::ref_ptr<vsg::Object>>> _deferred_unref_queue;
@@ -13,6 +13,8 @@
 
 using namespace ROCKY_NAMESPACE;
 
+#define LC "[TerrainEngine] "
+
 
 TerrainEngine::TerrainEngine(
     shared_ptr<Map> new_map,
@@ -27,8 +29,25 @@ TerrainEngine::TerrainEngine(
     settings(new_settings),
     geometryPool(worldSRS),
     tiles(new_map->profile(), new_settings, host),
-    stateFactory(new_runtime)
+    stateFactory(new_runtime, new_settings)
 {
     auto total_threads = std::thread::hardware_concurrency();
     jobs::get_pool(loadSchedulerName)->set_concurrency(total_threads/2);
+
+    // fetch jobs mostly wait on I/O
+    jobs::get_pool(fetchSchedulerName)->set_concurrency(total_threads);
+
+    if (settings.compressTextures == true && !runtime.deviceFeatures.textureCompressionBC)
+    {
+        Log()->warn(LC "The device does not support BC texture compression; terrain imagery will not be compressed");
+    }
+
+    // budget in bytes of heightfield data
+    const std::size_t elevation_cache_budget = 32u * 1024u * 1024u;
+    elevationCache = std::make_shared<TerrainTileModelFactory::ElevationCache>(
+        elevation_cache_budget,
+        4u, // shards
+        [](const TerrainTileModel::Elevation& e) -> std::size_t {
+            return e.heightfield.valid() ? e.heightfield.heightfield()->sizeInBytes() : 1u; });
+    elevationCache->plotNames = { "rocky.terrain_elevation_cache.hits", "rocky.terrain_elevation_cache.misses", "rocky.terrain_elevation_cache.evictions" };
 }
@@ -12,6 +12,7 @@
 #include <rocky/vsg/engine/GeometryPool.h>
 #include <rocky/vsg/engine/TerrainState.h>
 #include <rocky/vsg/engine/TerrainTilePager.h>
+#include <rocky/TerrainTileModelFactory.h>
 
 namespace ROCKY_NAMESPACE
 {
@@ -52,7 +53,14 @@ namespace ROCKY_NAMESPACE
         //! Creates the state group objects for terrain rendering
         TerrainState stateFactory;
 
+        //! Elevation tiles recently loaded, shared by the tile loaders
+        shared_ptr<TerrainTileModelFactory::ElevationCache> elevationCache;
+
         //! name of job arena used to load data
         std::string loadSchedulerName = "terrain.load";
+
+        //! name of job arena used to fetch individual layers concurrently
+        //! while loading a tile
+        std::string fetchSchedulerName = "terrain.fetch";
     };
 }
@@ -8,13 +8,16 @@
 #include "TerrainTileNode.h"
 #include "Utils.h"
 #include "PipelineState.h"
+#include "GeometryPool.h"
 
+#include <rocky/vsg/TerrainSettings.h>
 #include <rocky/Color.h>
 #include <rocky/Heightfield.h>
 #include <rocky/Image.h>
 
 #include <vsg/state/BindDescriptorSet.h>
 #include <vsg/state/ViewDependentState.h>
+#include <vsg/commands/DrawIndexed.h>
 
 #define TERRAIN_VERT_SHADER "shaders/rocky.terrain.vert"
 #define TERRAIN_FRAG_SHADER "shaders/rocky.terrain.frag"
@@ -39,8 +42,51 @@
 
 using namespace ROCKY_NAMESPACE;
 
-TerrainState::TerrainState(Runtime& runtime) :
-    _runtime(runtime)
+#define LC "[TerrainState] "
+
+namespace
+{
+    // Copy of a pooled tile geometry whose draw command starts at the
+    // given instance, which the bindless shaders use to find the tile's
+    // slot in the tile table. Shares all the vertex and index data.
+    vsg::ref_ptr<SharedGeometry> cloneWithFirstInstance(const SharedGeometry& geom, uint32_t firstInstance)
+    {
+        auto clone = SharedGeometry::create();
+        clone->firstBinding = geom.firstBinding;
+        clone->arrays = geom.arrays;
+        clone->indices = geom.indices;
+        clone->indexType = geom.indexType;
+        clone->hasConstraints = geom.hasConstraints;
+        clone->proxy_verts = geom.proxy_verts;
+        clone->proxy_normals = geom.proxy_normals;
+        clone->proxy_uvs = geom.proxy_uvs;
+        clone->proxy_indices = geom.proxy_indices;
+
+        for (auto& command : geom.commands)
+        {
+            auto draw = command->cast<vsg::DrawIndexed>();
+            if (draw)
+            {
+                clone->commands.push_back(vsg::DrawIndexed::create(
+                    draw->indexCount,
+                    draw->instanceCount,
+                    draw->firstIndex,
+                    draw->vertexOffset,
+                    firstInstance));
+            }
+            else
+            {
+                clone->commands.push_back(command);
+            }
+        }
+
+        return clone;
+    }
+}
+
+TerrainState::TerrainState(Runtime& runtime, const TerrainSettings& settings) :
+    _runtime(runtime),
+    _settings(settings)
 {
     status = StatusOK;
 
@@ -67,11 +113,12 @@ TerrainState::createDefaultDescriptors()
 
     // color channel
     // TODO: more than one - make this an array?
-    // TODO: activate mipmapping
+    // Trilinear + anisotropic filtering. The loader generates the full mipmap
+    // chain for each color image, so let the sampler use all of it.
     texturedefs.color = { COLOR_TEX_NAME, COLOR_TEX_BINDING, vsg::Sampler::create(), {} };
     texturedefs.color.sampler->minFilter = VK_FILTER_LINEAR;
     texturedefs.color.sampler->magFilter = VK_FILTER_LINEAR;
-    texturedefs.color.sampler->maxLod = 5;
+    texturedefs.color.sampler->maxLod = VK_LOD_CLAMP_NONE;
     texturedefs.color.sampler->mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     texturedefs.color.sampler->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     texturedefs.color.sampler->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
@@ -133,6 +180,38 @@ TerrainState::createDefaultDescriptors()
         texturedefs.normal.uniform_binding,
         0, // array element
         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+    // In bindless mode, all tiles share one set of texture arrays instead.
+    // The shaders pick each tile's textures with a per-instance index, which
+    // the device must support, and the arrays (two of them in the fragment
+    // stage, three in the set) must fit the device's descriptor limits with
+    // some room left for the other samplers the pipeline binds.
+    const uint32_t reserved = 16;
+    const uint32_t perStage = 2 * TerrainTileTable::capacity + reserved;
+    const uint32_t perSet = 3 * TerrainTileTable::capacity + reserved;
+    auto& limits = _runtime.deviceLimits;
+
+    if (_settings.bindless == true && !_runtime.deviceFeatures.shaderSampledImageArrayDynamicIndexing)
+    {
+        Log()->warn(LC "The device does not support dynamic indexing of texture arrays; bindless mode is disabled");
+    }
+    else if (_settings.bindless == true && (
+        limits.maxPerStageDescriptorSamplers < perStage ||
+        limits.maxPerStageDescriptorSampledImages < perStage ||
+        limits.maxPerStageResources < perStage ||
+        limits.maxDescriptorSetSamplers < perSet ||
+        limits.maxDescriptorSetSampledImages < perSet))
+    {
+        Log()->warn(LC "The device cannot bind " + std::to_string(perSet) + " textures at once; bindless mode is disabled");
+    }
+    else if (_settings.bindless == true)
+    {
+        tileTable = std::make_shared<TerrainTileTable>(
+            TerrainTileTable::TextureArrayDef{ texturedefs.elevation.uniform_binding, texturedefs.elevation.sampler, texturedefs.elevation.defaultData },
+            TerrainTileTable::TextureArrayDef{ texturedefs.color.uniform_binding, texturedefs.color.sampler, texturedefs.color.defaultData },
+            TerrainTileTable::TextureArrayDef{ texturedefs.normal.uniform_binding, texturedefs.normal.sampler, texturedefs.normal.defaultData },
+            TILE_BUFFER_BINDING);
+    }
 }
 
 vsg::ref_ptr<vsg::ShaderSet>
@@ -181,11 +260,16 @@ TerrainState::createShaderSet() const
     //shaderSet->addAttributeBinding(ATTR_VERTEX_NEIGHBOR, "", 3, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec3Array::create(1));
     //shaderSet->addAttributeBinding(ATTR_NORMAL_NEIGHBOR, "", 4, VK_FORMAT_R32G32B32A32_SFLOAT, vsg::vec3Array::create(1));
 
-    // "binding" (4th param) must match "layout(location=X) uniform" in the shader
-    shaderSet->addUniformBinding(texturedefs.elevation.name, "", 0, texturedefs.elevation.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_VERTEX_BIT, {});
-    shaderSet->addUniformBinding(texturedefs.color.name, "", 0, texturedefs.color.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, {});
-    shaderSet->addUniformBinding(texturedefs.normal.name, "", 0, texturedefs.normal.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, {});
-    shaderSet->addUniformBinding(TILE_BUFFER_NAME, "", 0, TILE_BUFFER_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, {});
+    // "binding" (4th param) must match "layout(location=X) uniform" in the shader.
+    // In bindless mode each texture binding is an array holding every tile's
+    // texture, and the per-tile data is a storage buffer indexed by tile.
+    const uint32_t textureCount = tileTable ? TerrainTileTable::capacity : 1;
+    const VkDescriptorType tileBufferType = tileTable ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    shaderSet->addUniformBinding(texturedefs.elevation.name, "", 0, texturedefs.elevation.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount, VK_SHADER_STAGE_VERTEX_BIT, {});
+    shaderSet->addUniformBinding(texturedefs.color.name, "", 0, texturedefs.color.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount, VK_SHADER_STAGE_FRAGMENT_BIT, {});
+    shaderSet->addUniformBinding(texturedefs.normal.name, "", 0, texturedefs.normal.uniform_binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount, VK_SHADER_STAGE_FRAGMENT_BIT, {});
+    shaderSet->addUniformBinding(TILE_BUFFER_NAME, "", 0, TILE_BUFFER_BINDING, tileBufferType, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, {});
     
     PipelineUtils::addViewDependentData(shaderSet, VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -207,7 +291,27 @@ TerrainState::createPipelineConfig() const
     auto config = vsg::GraphicsPipelineConfig::create(shaderSet);
 
     // Apply any custom compile settings / defines:
-    config->shaderHints = _runtime.shaderCompileSettings;
+    std::set<std::string> defines;
+
+    if (tileTable)
+        defines.insert("RK_BINDLESS");
+
+    if (_settings.useNormalMaps == true)
+        defines.insert("RK_NORMAL_MAPS");
+
+    if (!defines.empty())
+    {
+        // clone, since we are adding our own defines
+        config->shaderHints = _runtime.shaderCompileSettings ?
+            vsg::ShaderCompileSettings::create(*_runtime.shaderCompileSettings) :
+            vsg::ShaderCompileSettings::create();
+
+        config->shaderHints->defines.insert(defines.begin(), defines.end());
+    }
+    else
+    {
+        config->shaderHints = _runtime.shaderCompileSettings;
+    }
 
     // activate the arrays we intend to use
     config->enableArray(ATTR_VERTEX, VK_VERTEX_INPUT_RATE_VERTEX, 12);
@@ -257,18 +361,53 @@ TerrainState::createTerrainStateGroup()
     stateGroup->add(pipelineConfig->bindGraphicsPipeline);
     stateGroup->add(PipelineUtils::createViewDependentBindCommand(pipelineConfig));
 
+    // In bindless mode, the descriptors of all tiles go here too.
+    if (tileTable)
+    {
+        tileTable->install(
+            stateGroup,
+            pipelineConfig->layout,
+            pipelineConfig->layout->setLayouts.front());
+    }
+
     return stateGroup;
 }
 
 void
 TerrainState::updateTerrainTileDescriptors(
-    const TerrainTileRenderModel& renderModel,
-    vsg::ref_ptr<vsg::StateGroup> stategroup,
-    Runtime& runtime) const
+    TerrainTileNode& tile,
+    Runtime& runtime,
+    bool batch) const
 {
     ROCKY_SOFT_ASSERT_AND_RETURN(status.ok(), void());
     ROCKY_SOFT_ASSERT_AND_RETURN(pipelineConfig.valid(), void());
-    ROCKY_SOFT_ASSERT_AND_RETURN(stategroup.valid(), void());
+    ROCKY_SOFT_ASSERT_AND_RETURN(tile.stategroup.valid(), void());
+
+    auto& renderModel = tile.renderModel;
+    auto& stategroup = tile.stategroup;
+
+    if (tileTable)
+    {
+        if (!tile.tableEntry)
+        {
+            // First update, before the tile joins the scene graph: reserve its
+            // slot, and draw it with a geometry that carries the slot.
+            tile.tableEntry = tileTable->reserve();
+
+            auto geom = tile.tableEntry ? stategroup->children.front()->cast<SharedGeometry>() : nullptr;
+            if (geom)
+            {
+                stategroup->children.front() = cloneWithFirstInstance(*geom, tile.tableEntry->slot);
+            }
+        }
+
+        // The table batches its own descriptor updates.
+        if (tile.tableEntry)
+        {
+            tileTable->update(*tile.tableEntry, renderModel, runtime);
+        }
+        return;
+    }
 
     // Takes a tile's render model (which holds the raw image and matrix data)
     // and creates the necessary VK data to render that model.
@@ -278,13 +417,14 @@ TerrainState::updateTerrainTileDescriptors(
 
     if (renderModel.color.image)
     {
-        auto data = util::moveImageToVSG(renderModel.color.image->clone());
+        auto data = util::shareImageWithVSG(renderModel.color.image);
         if (data)
         {
             // queue the old data for safe disposal
             runtime.dispose(dm.color);
 
-            // tell vsg to remove the image from CPU memory after sending it to the GPU
+            // tell vsg to release the image after sending it to the GPU; the
+            // render model keeps its own reference for as long as it needs one
             data->properties.dataVariance = vsg::STATIC_DATA_UNREF_AFTER_TRANSFER;
 
             dm.color = vsg::DescriptorImage::create(
@@ -300,13 +440,14 @@ TerrainState::updateTerrainTileDescriptors(
 
     if (renderModel.elevation.image)
     {
-        auto data = util::moveImageToVSG(renderModel.elevation.image->clone());
+        auto data = util::shareImageWithVSG(renderModel.elevation.image);
         if (data)
         {
             // queue the old data for safe disposal
             runtime.dispose(dm.elevation);
 
-            // tell vsg to remove the image from CPU memory after sending it to the GPU
+            // tell vsg to release the image after sending it to the GPU; the
+            // render model keeps its own reference for as long as it needs one
             data->properties.dataVariance = vsg::STATIC_DATA_UNREF_AFTER_TRANSFER;
 
             dm.elevation = vsg::DescriptorImage::create(
@@ -322,13 +463,14 @@ TerrainState::updateTerrainTileDescriptors(
 
     if (renderModel.normal.image)
     {
-        auto data = util::moveImageToVSG(renderModel.normal.image->clone());
+        auto data = util::shareImageWithVSG(renderModel.normal.image);
         if (data)
         {
             // queue the old data for safe disposal
             runtime.dispose(dm.normal);
 
-            // tell vsg to remove the image from CPU memory after sending it to the GPU
+            // tell vsg to release the image after sending it to the GPU; the
+            // render model keeps its own reference for as long as it needs one
             data->properties.dataVariance = vsg::STATIC_DATA_UNREF_AFTER_TRANSFER;
 
             dm.normal = vsg::DescriptorImage::create(
@@ -379,25 +521,37 @@ TerrainState::updateTerrainTileDescriptors(
     
     stategroup->stateCommands.clear();
 
-    // Need to compile the descriptors
-    runtime.compile(bind);
-
     // Temporary:
     // Delete the CPU memory assocaited with the rasters
-    // now that they are compiled to the GPU.
-    for (auto& dd : bind->descriptorSet->descriptors)
+    // once they are compiled to the GPU.
+    auto release_rasters = [bind]()
     {
-        auto di = dd->cast<vsg::DescriptorImage>();
-        if (di)
+        for (auto& dd : bind->descriptorSet->descriptors)
         {
-            for (auto& ii : di->imageInfoList)
+            auto di = dd->cast<vsg::DescriptorImage>();
+            if (di)
             {
-                if (ii->imageView->image->data->properties.dataVariance == vsg::STATIC_DATA_UNREF_AFTER_TRANSFER)
+                for (auto& ii : di->imageInfoList)
                 {
-                    ii->imageView->image->data = nullptr;
+                    if (ii->imageView->image->data &&
+                        ii->imageView->image->data->properties.dataVariance == vsg::STATIC_DATA_UNREF_AFTER_TRANSFER)
+                    {
+                        ii->imageView->image->data = nullptr;
+                    }
                 }
             }
         }
+    };
+
+    // Need to compile the descriptors
+    if (batch)
+    {
+        runtime.compileInBatch(bind, release_rasters);
+    }
+    else
+    {
+        runtime.compile(bind);
+        release_rasters();
     }
 
     // And update the tile's state group
@@ -7,6 +7,7 @@
 
 #include <rocky/vsg/Common.h>
 #include <rocky/vsg/engine/TerrainTileNode.h>
+#include <rocky/vsg/engine/TerrainTileTable.h>
 
 #include <vsg/io/Options.h>
 #include <vsg/utils/GraphicsPipelineConfigurator.h>
@@ -17,6 +18,7 @@
 namespace ROCKY_NAMESPACE
 {
     class Runtime;
+    class TerrainSettings;
     class TerrainTileNode;
     class TerrainTileRenderModel;
 
@@ -34,16 +36,23 @@ namespace ROCKY_NAMESPACE
     {
     public:
         //! Initialize the factory
-        TerrainState(Runtime&);
+        TerrainState(Runtime&, const TerrainSettings&);
 
         //! Creates a state group for rendering terrain
         vsg::ref_ptr<vsg::StateGroup> createTerrainStateGroup();
 
-        //! Creates a state group for rendering a specific terrain tile
+        //! Updates the descriptors that render a specific terrain tile
+        //! from its render model. In bindless mode this updates the tile's
+        //! slot in the tile table instead.
+        //! @param tile Tile to update
+        //! @param runtime Runtime to use for compilation
+        //! @param batch If true, compile the descriptors along with all the others
+        //!   merged this frame (see Runtime::compileInBatch). Only pass true
+        //!   from the update pass.
         void updateTerrainTileDescriptors(
-            const TerrainTileRenderModel& renderModel,
-            vsg::ref_ptr<vsg::StateGroup> stategroup,
-            Runtime& runtime) const;
+            TerrainTileNode& tile,
+            Runtime& runtime,
+            bool batch = false) const;
 
         //! Status of the factory.
         Status status;
@@ -63,6 +72,10 @@ namespace ROCKY_NAMESPACE
         //! Terrain tiles copy and use this until new data becomes available.
         TerrainTileDescriptors defaultTileDescriptors;
 
+        //! Textures and data of all tiles, in bindless mode (TerrainSettings::bindless);
+        //! otherwise null.
+        shared_ptr<TerrainTileTable> tileTable;
+
     protected:
 
         //! Creates all the default texture information,
@@ -106,5 +119,6 @@ namespace ROCKY_NAMESPACE
         texturedefs;
 
         Runtime& _runtime;
+        const TerrainSettings& _settings;
     };
 }
@@ -8,6 +8,7 @@
 #include <rocky/vsg/Common.h>
 #include <rocky/vsg/engine/SurfaceNode.h>
 #include <rocky/vsg/engine/TerrainTileHost.h>
+#include <rocky/vsg/engine/TerrainTileTable.h>
 #include <rocky/Threading.h>
 #include <rocky/TileKey.h>
 #include <rocky/Image.h>
@@ -105,6 +106,9 @@ namespace ROCKY_NAMESPACE
         
         vsg::ref_ptr<SurfaceNode> surface;
         vsg::ref_ptr<vsg::StateGroup> stategroup;
+
+        //! This tile's slot in the terrain's tile table (bindless mode only)
+        std::unique_ptr<TerrainTileTable::Entry> tableEntry;
         
         mutable jobs::future<bool> subtilesLoader;
         //mutable jobs::future<TerrainTileModel> elevationLoader;
@@ -318,8 +318,7 @@ TerrainTilePager::createTile(
 
     // Generate its state group:
     terrain->stateFactory.updateTerrainTileDescriptors(
-        tile->renderModel,
-        tile->stategroup,
+        *tile,
         terrain->runtime);
 
     return tile;
@@ -438,6 +437,10 @@ TerrainTilePager::requestLoadData(
         TerrainTileModelFactory factory;
 
         factory.compositeColorLayers = true;
+        factory.createNormalMaps = (engine->settings.useNormalMaps == true);
+        factory.normalizeEdges = (engine->settings.normalizeEdges == true);
+        factory.fetchSchedulerName = engine->fetchSchedulerName;
+        factory.elevationCache = engine->elevationCache;
 
         auto model = factory.createTileModel(
             engine->map.get(),
@@ -445,6 +448,42 @@ TerrainTilePager::requestLoadData(
             manifest,
             IOOptions(io, p));
 
+        for (auto& layer : model.colorLayers)
+        {
+            auto image = layer.image.image();
+            if (!image || image->compressed())
+                continue;
+
+            // Mipmap here in the loader thread; the GPU can't generate
+            // mipmaps for compressed formats. Always into a new image: the
+            // layer may be handing the same one to other tiles.
+            auto mipmapped = image->generateMipmaps();
+            if (mipmapped)
+            {
+                image = mipmapped;
+                layer.image = GeoImage(image, layer.image.extent());
+            }
+
+            // compress the imagery so the GPU upload and texture memory
+            // are 4-8x smaller:
+            if (engine->settings.compressTextures == true &&
+                engine->runtime.deviceFeatures.textureCompressionBC)
+            {
+                auto compressed = image->compress(
+                    image->hasAlphaChannel() ? Image::BC3_UNORM : Image::BC1_RGBA_UNORM);
+
+                if (compressed)
+                    layer.image = GeoImage(compressed, layer.image.extent());
+            }
+        }
+
+        if (model.normalMap.image.valid())
+        {
+            auto mipmapped = model.normalMap.image.image()->generateMipmaps();
+            if (mipmapped)
+                model.normalMap.image = GeoImage(mipmapped, model.normalMap.image.extent());
+        }
+
         return model;
     };
 
@@ -536,7 +575,7 @@ TerrainTilePager::requestMergeData(
 
         if (model.normalMap.image.valid())
         {
-            renderModel.elevation.name = "normal " + model.normalMap.key.str();
+            renderModel.normal.name = "normal " + model.normalMap.key.str();
             renderModel.normal.image = model.normalMap.image.image();
             renderModel.normal.matrix = model.normalMap.matrix;
 
@@ -549,9 +588,9 @@ TerrainTilePager::requestMergeData(
         if (updated)
         {
             engine->stateFactory.updateTerrainTileDescriptors(
-                renderModel,
-                tile->stategroup,
-                engine->runtime);
+                *tile,
+                engine->runtime,
+                true); // batch
 
             //RP_DEBUG << "mergeData -> " << key.str() << std::endl;
         }
@@ -695,9 +734,9 @@ TerrainTilePager::requestMergeElevation(
             if (updated)
             {
                 engine->stateFactory.updateTerrainTileDescriptors(
-                    renderModel,
-                    tile->stategroup,
-                    engine->runtime);
+                    *tile,
+                    engine->runtime,
+                    true); // batch
 
                 Log::info() << "Elevation merged for " << key.str() << std::endl;
             }
@@ -0,0 +1,460 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#include "TerrainTileTable.h"
+#include "TerrainTileNode.h"
+#include "Runtime.h"
+#include "Utils.h"
+
+#include <vsg/state/DescriptorSet.h>
+#include <vsg/app/Viewer.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ROCKY_NAMESPACE;
+
+#define LC "[TerrainTileTable] "
+
+namespace
+{
+    // Runs a function during the compile traversal of the runtime's batch.
+    // The table uses it to compile its new textures, so their GPU images
+    // exist before it writes them into its descriptor sets. Records nothing.
+    class CompileFunction : public vsg::Inherit<vsg::Command, CompileFunction>
+    {
+    public:
+        std::function<void(vsg::Context&)> function;
+
+        void compile(vsg::Context& context) override
+        {
+            if (function)
+                function(context);
+        }
+
+        void record(vsg::CommandBuffer&) const override { }
+    };
+}
+
+TerrainTileTable::Entry::~Entry()
+{
+    _table->release(slot);
+}
+
+TerrainTileTable::TerrainTileTable(
+    const TextureArrayDef& elevation,
+    const TextureArrayDef& color,
+    const TextureArrayDef& normal,
+    uint32_t tileBufferBinding)
+{
+    const TextureArrayDef* defs[3] = { &elevation, &color, &normal };
+
+    for (unsigned type = 0; type < 3; ++type)
+    {
+        auto& array = _arrays[type];
+        array.binding = defs[type]->binding;
+        array.sampler = defs[type]->sampler;
+
+        // unused slots all point at the placeholder texture, since every
+        // element of the descriptor array must be valid.
+        auto placeholder = vsg::ImageInfo::create(
+            defs[type]->sampler,
+            defs[type]->defaultData,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        array.images.assign(capacity, placeholder);
+        array.owners.assign(capacity, nullptr);
+        array.compiled.assign(capacity, true); // the sets compile the placeholder
+
+        // slot 0 is permanently the placeholder:
+        array.freeSlots.reserve(capacity - 1);
+        for (unsigned slot = capacity - 1; slot > 0; --slot)
+            array.freeSlots.push_back(slot);
+    }
+
+    _tiles.resize(capacity);
+    _freeTileSlots.reserve(capacity - 1);
+    for (unsigned slot = capacity - 1; slot > 0; --slot)
+        _freeTileSlots.push_back(slot);
+
+    // One storage buffer holds every tile's data. It changes whenever tiles
+    // do, so VSG re-uploads it when we dirty it.
+    _tileBuffer = vsg::ubyteArray::create(capacity * sizeof(TileData));
+    _tileBuffer->properties.dataVariance = vsg::DYNAMIC_DATA;
+    std::memcpy(_tileBuffer->dataPointer(), _tiles.data(), capacity * sizeof(TileData));
+
+    _tileDescriptor = vsg::DescriptorBuffer::create(
+        _tileBuffer,
+        tileBufferBinding,
+        0, // array element
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+}
+
+void
+TerrainTileTable::install(
+    vsg::ref_ptr<vsg::StateGroup> stategroup,
+    vsg::ref_ptr<vsg::PipelineLayout> layout,
+    vsg::ref_ptr<vsg::DescriptorSetLayout> setLayout)
+{
+    ROCKY_SOFT_ASSERT_AND_RETURN(stategroup && layout && setLayout, void());
+
+    std::scoped_lock lock(_mutex);
+
+    for (auto& set : _sets)
+    {
+        vsg::Descriptors descriptors;
+
+        for (unsigned type = 0; type < 3; ++type)
+        {
+            // each set gets its own copy of the image lists, since each
+            // one keeps the textures it uses alive:
+            set.images[type] = vsg::DescriptorImage::create(
+                _arrays[type].images,
+                _arrays[type].binding,
+                0, // first array element
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+            descriptors.push_back(set.images[type]);
+        }
+
+        descriptors.push_back(_tileDescriptor);
+
+        set.bind = vsg::BindDescriptorSet::create(
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            layout,
+            0, // first set
+            vsg::DescriptorSet::create(setLayout, descriptors));
+    }
+
+    _stategroup = stategroup;
+    _current = 0;
+    _stategroup->add(_sets[_current].bind);
+}
+
+std::unique_ptr<TerrainTileTable::Entry>
+TerrainTileTable::reserve()
+{
+    std::scoped_lock lock(_mutex);
+
+    if (_freeTileSlots.empty())
+    {
+        if (!_warnedFull)
+        {
+            Log()->warn(LC "Tile table is full (" + std::to_string(capacity) + " tiles); the extra tiles will render without data");
+            _warnedFull = true;
+        }
+        return nullptr;
+    }
+
+    unsigned slot = _freeTileSlots.back();
+    _freeTileSlots.pop_back();
+
+    return std::unique_ptr<Entry>(new Entry(shared_from_this(), slot));
+}
+
+void
+TerrainTileTable::update(Entry& entry, const TerrainTileRenderModel& renderModel, Runtime& runtime)
+{
+    std::scoped_lock lock(_mutex);
+
+    schedule(runtime);
+
+    auto& tile = _tiles[entry.slot];
+
+    // acquire the new textures before releasing the old ones, so a tile
+    // that keeps an image also keeps its slot.
+    int elevation = acquireTexture(ELEVATION, renderModel.elevation.image);
+    int color = acquireTexture(COLOR, renderModel.color.image);
+    int normal = acquireTexture(NORMAL, renderModel.normal.image);
+
+    releaseTexture(ELEVATION, tile.elevation_index);
+    releaseTexture(COLOR, tile.color_index);
+    releaseTexture(NORMAL, tile.normal_index);
+
+    tile.elevation_matrix = renderModel.elevation.matrix;
+    tile.color_matrix = renderModel.color.matrix;
+    tile.normal_matrix = renderModel.normal.matrix;
+    tile.model_matrix = renderModel.modelMatrix;
+    tile.elevation_index = elevation;
+    tile.color_index = color;
+    tile.normal_index = normal;
+}
+
+int
+TerrainTileTable::acquireTexture(unsigned type, shared_ptr<Image> image)
+{
+    if (!image)
+        return 0;
+
+    auto& array = _arrays[type];
+
+    auto iter = array.textures.find(image.get());
+    if (iter != array.textures.end())
+    {
+        ++iter->second.refs;
+        return iter->second.slot;
+    }
+
+    if (array.freeSlots.empty())
+    {
+        if (!_warnedFull)
+        {
+            Log()->warn(LC "Texture array is full (" + std::to_string(capacity) + " textures); the extra tiles will render without data");
+            _warnedFull = true;
+        }
+        return 0;
+    }
+
+    auto data = util::shareImageWithVSG(image);
+    if (!data)
+        return 0;
+
+    // tell vsg to release the image after sending it to the GPU; the
+    // render model keeps its own reference for as long as it needs one
+    data->properties.dataVariance = vsg::STATIC_DATA_UNREF_AFTER_TRANSFER;
+
+    unsigned slot = array.freeSlots.back();
+    array.freeSlots.pop_back();
+
+    auto info = vsg::ImageInfo::create(array.sampler, data, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    array.images[slot] = info;
+    array.owners[slot] = image.get();
+    array.textures[image.get()] = Texture{ image, slot, 1 };
+    markDirty(type, slot);
+
+    array.compiled[slot] = false;
+
+    if (_stategroup)
+        _uploads.push_back(Upload{ type, slot, info });
+
+    return slot;
+}
+
+void
+TerrainTileTable::releaseTexture(unsigned type, int slot)
+{
+    if (slot <= 0)
+        return;
+
+    auto& array = _arrays[type];
+
+    auto iter = array.textures.find(array.owners[slot]);
+    ROCKY_SOFT_ASSERT_AND_RETURN(iter != array.textures.end(), void());
+
+    if (--iter->second.refs == 0)
+    {
+        // Descriptor sets still holding the old image keep it alive
+        // until their slot is rewritten.
+        array.textures.erase(iter);
+        array.images[slot] = array.images[0];
+        array.owners[slot] = nullptr;
+        array.compiled[slot] = true;
+        array.freeSlots.push_back(slot);
+        markDirty(type, slot);
+    }
+}
+
+void
+TerrainTileTable::markDirty(unsigned type, unsigned slot)
+{
+    for (auto& set : _sets)
+        set.dirty[type].push_back(slot);
+}
+
+void
+TerrainTileTable::schedule(Runtime& runtime)
+{
+    // Publish all of this frame's changes at once, after the runtime
+    // compiles its next batch. The batch compiles the descriptor sets
+    // (once) and the textures acquired before its compile traversal starts.
+    // Call with the mutex locked.
+    if (_scheduled || !_stategroup)
+        return;
+
+    _scheduled = true;
+
+    auto objects = vsg::Objects::create();
+    for (auto& set : _sets)
+        objects->addChild(set.bind);
+
+    // Tiles can acquire textures on other threads while the batch compiles,
+    // so take the uploads at the start of the traversal and leave anything
+    // later for the next batch. Only these get published by commit().
+    struct Batch
+    {
+        std::vector<Upload> uploads;
+        vsg::ref_ptr<vsg::DescriptorImage> textures;
+    };
+
+    auto self = shared_from_this();
+    auto batch = std::make_shared<Batch>();
+
+    auto compile = CompileFunction::create();
+    compile->function = [self, batch](vsg::Context& context)
+        {
+            // take once; the traversal may visit us once per device context
+            if (!batch->textures)
+            {
+                batch->textures = vsg::DescriptorImage::create(
+                    vsg::ImageInfoList{},
+                    0, 0, // unused; this is never bound
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+                {
+                    std::scoped_lock lock(self->_mutex);
+                    batch->uploads.swap(self->_uploads);
+                }
+
+                for (auto& upload : batch->uploads)
+                    batch->textures->imageInfoList.push_back(upload.info);
+            }
+
+            if (!batch->textures->imageInfoList.empty())
+                batch->textures->compile(context);
+        };
+    objects->addChild(compile);
+
+    runtime.compileInBatch(objects, [self, batch, &runtime]() { self->commit(runtime, batch->uploads); });
+}
+
+void
+TerrainTileTable::release(unsigned slot)
+{
+    std::scoped_lock lock(_mutex);
+
+    auto& tile = _tiles[slot];
+    releaseTexture(ELEVATION, tile.elevation_index);
+    releaseTexture(COLOR, tile.color_index);
+    releaseTexture(NORMAL, tile.normal_index);
+    tile = TileData();
+
+    // no need to publish; nothing draws this slot until it's reserved again
+    _freeTileSlots.push_back(slot);
+}
+
+void
+TerrainTileTable::commit(Runtime& runtime, const std::vector<Upload>& compiled)
+{
+    {
+        std::scoped_lock lock(_mutex);
+
+        _scheduled = false;
+
+        // mark the batch's textures as ready, unless their slot
+        // changed hands since the batch took them:
+        for (auto& upload : compiled)
+        {
+            auto& array = _arrays[upload.type];
+            if (array.images[upload.slot] == upload.info)
+                array.compiled[upload.slot] = true;
+        }
+
+        // Tiles whose textures are not compiled yet point at the placeholder
+        // until a later commit publishes them.
+        auto tiles = reinterpret_cast<TileData*>(_tileBuffer->dataPointer());
+        std::memcpy(tiles, _tiles.data(), capacity * sizeof(TileData));
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            auto& tile = tiles[i];
+            if (!_arrays[ELEVATION].compiled[tile.elevation_index]) tile.elevation_index = 0;
+            if (!_arrays[COLOR].compiled[tile.color_index]) tile.color_index = 0;
+            if (!_arrays[NORMAL].compiled[tile.normal_index]) tile.normal_index = 0;
+        }
+        _tileBuffer->dirty();
+
+        auto device = !runtime.viewer->windows().empty() ? runtime.viewer->windows().front()->getDevice() : vsg::ref_ptr<vsg::Device>{ };
+        ROCKY_SOFT_ASSERT_AND_RETURN(device, void());
+        auto deviceID = device->deviceID;
+
+        // Write this frame's changes, and any the set missed while it was in
+        // use, into the next set. It was last bound setCount publishes ago, so
+        // no frame in flight still uses it.
+        unsigned next = (_current + 1) % setCount;
+        auto& set = _sets[next];
+
+        std::size_t count = 0;
+        for (auto& dirty : set.dirty)
+        {
+            std::sort(dirty.begin(), dirty.end());
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+            count += dirty.size();
+        }
+
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        std::vector<VkWriteDescriptorSet> writes;
+        imageInfos.reserve(count); // writes point into it
+        writes.reserve(count);
+
+        VkDescriptorSet vk_set = set.bind->descriptorSet->vk(deviceID);
+
+        for (unsigned type = 0; type < 3; ++type)
+        {
+            auto& array = _arrays[type];
+            auto& images = set.images[type]->imageInfoList;
+            std::vector<unsigned> deferred;
+
+            for (auto slot : set.dirty[type])
+            {
+                // not on the GPU yet; try again next commit
+                if (!array.compiled[slot])
+                {
+                    deferred.push_back(slot);
+                    continue;
+                }
+
+                auto& info = array.images[slot];
+                images[slot] = info;
+
+                imageInfos.push_back(VkDescriptorImageInfo{
+                    info->sampler->vk(deviceID),
+                    info->imageView->vk(deviceID),
+                    info->imageLayout });
+
+                VkWriteDescriptorSet write = {};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = vk_set;
+                write.dstBinding = array.binding;
+                write.dstArrayElement = slot;
+                write.descriptorCount = 1;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                write.pImageInfo = &imageInfos.back();
+                writes.push_back(write);
+            }
+
+            set.dirty[type].swap(deferred);
+        }
+
+        if (!writes.empty())
+        {
+            vkUpdateDescriptorSets(*device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+        }
+
+        // Swap in the next set. The old one stays compiled for its next turn.
+        for (auto& command : _stategroup->stateCommands)
+        {
+            if (command == _sets[_current].bind)
+            {
+                command = set.bind;
+            }
+        }
+
+        _current = next;
+
+        // textures acquired during the batch need a batch of their own
+        if (!_uploads.empty())
+            schedule(runtime);
+    }
+
+    // Delete the CPU memory associated with the rasters
+    // once they are compiled to the GPU.
+    for (auto& upload : compiled)
+    {
+        auto& info = upload.info;
+        if (info->imageView && info->imageView->image->data &&
+            info->imageView->image->data->properties.dataVariance == vsg::STATIC_DATA_UNREF_AFTER_TRANSFER)
+        {
+            info->imageView->image->data = nullptr;
+        }
+    }
+}
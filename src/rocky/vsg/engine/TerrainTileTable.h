@@ -0,0 +1,181 @@
+/**
+ * rocky c++
+ * Copyright 2023 Pelican Mapping
+ * MIT License
+ */
+#pragma once
+
+#include <rocky/vsg/Common.h>
+#include <rocky/Image.h>
+
+#include <vsg/state/BindDescriptorSet.h>
+#include <vsg/state/DescriptorBuffer.h>
+#include <vsg/state/DescriptorImage.h>
+#include <vsg/state/PipelineLayout.h>
+#include <vsg/nodes/StateGroup.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ROCKY_NAMESPACE
+{
+    class Runtime;
+    class TerrainTileRenderModel;
+
+    /**
+     * Terrain-wide table of tile rasters and per-tile data, for rendering
+     * the whole terrain with a single descriptor set ("bindless" mode).
+     *
+     * Each raster type (elevation, color, normal) lives in a descriptor array
+     * of textures, and each tile has a slot in a storage buffer holding its
+     * matrices and the array indices of its textures. A tile's draw command
+     * carries its slot in firstInstance, so the shaders find the tile's data
+     * at gl_InstanceIndex.
+     *
+     * Rasters are shared by identity: tiles that inherit their parent's
+     * images point at the same texture slot instead of uploading another
+     * copy. Changes are published once per frame, after the runtime compiles
+     * its batch; textures acquired after the batch starts compiling wait for
+     * the next one, and their tiles use the placeholder until then. The table rotates through a few persistent descriptor sets,
+     * compiled once; publishing writes only the slots that changed into the
+     * next set and binds it, so the storage buffer and the texture arrays
+     * change together and no set is written while frames in flight use it.
+     */
+    class ROCKY_VSG_INTERNAL TerrainTileTable : public std::enable_shared_from_this<TerrainTileTable>
+    {
+    public:
+        //! Number of slots in each array. Must match RK_TILE_TABLE_SIZE in the terrain shaders.
+        static const unsigned capacity = 4096;
+
+        //! Per-tile data in the storage buffer (std430 layout)
+        struct TileData
+        {
+            glm::fmat4 elevation_matrix{ 1 };
+            glm::fmat4 color_matrix{ 1 };
+            glm::fmat4 normal_matrix{ 1 };
+            glm::fmat4 model_matrix{ 1 };
+            std::int32_t elevation_index = 0;
+            std::int32_t color_index = 0;
+            std::int32_t normal_index = 0;
+            std::int32_t padding = 0;
+        };
+
+        //! A tile's reservation in the table. Destroying it frees the slot
+        //! and releases the tile's textures.
+        class ROCKY_VSG_INTERNAL Entry
+        {
+        public:
+            //! Index of the tile's slot; pass it to the draw command as firstInstance
+            const unsigned slot;
+
+            ~Entry();
+
+        private:
+            Entry(shared_ptr<TerrainTileTable> table, unsigned in_slot) : slot(in_slot), _table(table) { }
+            shared_ptr<TerrainTileTable> _table;
+            friend class TerrainTileTable;
+        };
+
+        //! Binding and placeholder texture of one texture array
+        struct TextureArrayDef
+        {
+            uint32_t binding;
+            vsg::ref_ptr<vsg::Sampler> sampler;
+            vsg::ref_ptr<vsg::Data> defaultData;
+        };
+
+    public:
+        //! Construct the table
+        //! @param elevation Binding and default texture of the elevation array
+        //! @param color Binding and default texture of the color array
+        //! @param normal Binding and default texture of the normal array
+        //! @param tileBufferBinding Binding of the per-tile storage buffer
+        TerrainTileTable(
+            const TextureArrayDef& elevation,
+            const TextureArrayDef& color,
+            const TextureArrayDef& normal,
+            uint32_t tileBufferBinding);
+
+        //! Creates the table's descriptor sets and binds one on the state group,
+        //! swapping in the next as the table changes.
+        //! Call once with the terrain's state group.
+        void install(
+            vsg::ref_ptr<vsg::StateGroup> stategroup,
+            vsg::ref_ptr<vsg::PipelineLayout> layout,
+            vsg::ref_ptr<vsg::DescriptorSetLayout> setLayout);
+
+        //! Reserves a tile slot.
+        //! @return Entry, or nullptr if the table is full
+        std::unique_ptr<Entry> reserve();
+
+        //! Updates a tile's textures and matrices. The change becomes visible
+        //! once the runtime compiles its next batch.
+        void update(
+            Entry& entry,
+            const TerrainTileRenderModel& renderModel,
+            Runtime& runtime);
+
+    private:
+        enum { ELEVATION = 0, COLOR = 1, NORMAL = 2 };
+
+        //! Number of descriptor sets in rotation. A set is rewritten only after
+        //! this many publishes, which must exceed the frames VSG keeps in flight.
+        static const unsigned setCount = 4;
+
+        struct Texture
+        {
+            shared_ptr<Image> image; // keeps the address unique while in use
+            unsigned slot = 0;
+            unsigned refs = 0;
+        };
+
+        //! One of the persistent descriptor sets
+        struct DescriptorSet
+        {
+            vsg::ref_ptr<vsg::BindDescriptorSet> bind;
+            vsg::ref_ptr<vsg::DescriptorImage> images[3]; // holds the textures the set uses
+            std::vector<unsigned> dirty[3]; // slots changed since the set was last written
+        };
+
+        //! A new texture waiting for a batch to compile it
+        struct Upload
+        {
+            unsigned type;
+            unsigned slot;
+            vsg::ref_ptr<vsg::ImageInfo> info;
+        };
+
+        struct TextureArray
+        {
+            uint32_t binding = 0;
+            vsg::ref_ptr<vsg::Sampler> sampler;
+            vsg::ImageInfoList images; // one per slot; slot 0 is the placeholder
+            std::vector<const Image*> owners; // image in each slot
+            std::vector<bool> compiled; // whether each slot's texture is on the GPU yet
+            std::unordered_map<const Image*, Texture> textures;
+            std::vector<unsigned> freeSlots;
+        };
+
+        std::mutex _mutex;
+        TextureArray _arrays[3];
+        std::vector<TileData> _tiles; // slot 0 is the placeholder
+        std::vector<unsigned> _freeTileSlots;
+        vsg::ref_ptr<vsg::ubyteArray> _tileBuffer;
+        vsg::ref_ptr<vsg::DescriptorBuffer> _tileDescriptor;
+        std::vector<Upload> _uploads; // not yet taken by a batch
+
+        vsg::ref_ptr<vsg::StateGroup> _stategroup;
+        DescriptorSet _sets[setCount];
+        unsigned _current = 0; // index of the set on the state group
+        bool _scheduled = false;
+        bool _warnedFull = false;
+
+        int acquireTexture(unsigned type, shared_ptr<Image> image);
+        void releaseTexture(unsigned type, int slot);
+        void release(unsigned slot);
+        void markDirty(unsigned type, unsigned slot);
+        void schedule(Runtime& runtime);
+        void commit(Runtime& runtime, const std::vector<Upload>& compiled);
+    };
+}
@@ -74,16 +74,22 @@ namespace ROCKY_NAMESPACE
             // NB!
             // We copy the values out of image FIRST because once we call
             // image->releaseData() they will all reset!
+            // For compressed formats, VSG measures the array in blocks.
             unsigned
-                width = image->width(),
-                height = image->height(),
-                depth = image->depth();
+                block = image->blockSize(),
+                width = (image->width() + block - 1) / block,
+                height = (image->height() + block - 1) / block,
+                depth = image->depth(),
+                mipmaps = image->mipmapLevels();
 
             T* data = reinterpret_cast<T*>(image->releaseData());
 
             vsg::Data::Properties props;
             props.format = format;
             props.allocatorType = vsg::ALLOCATOR_TYPE_NEW_DELETE;
+            props.blockWidth = block;
+            props.blockHeight = block;
+            props.maxNumMipmaps = mipmaps;
 
             vsg::ref_ptr<vsg::Data> vsg_data;
             if (depth == 1)
@@ -138,6 +144,12 @@ namespace ROCKY_NAMESPACE
             case Image::R64_SFLOAT:
                 return move<double>(image, VK_FORMAT_R64_SFLOAT);
                 break;
+            case Image::BC1_RGBA_UNORM:
+                return move<vsg::block64>(image, VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+                break;
+            case Image::BC3_UNORM:
+                return move<vsg::block128>(image, VK_FORMAT_BC3_UNORM_BLOCK);
+                break;
             };
 
             return { };
@@ -154,7 +166,99 @@ namespace ROCKY_NAMESPACE
 
             auto data = moveImageData(image);
             data->properties.origin = vsg::TOP_LEFT;
-            data->properties.maxNumMipmaps = 1;
+
+            return data;
+        }
+
+        //! VSG array that points at the pixels of a rocky Image without copying
+        //! them. It holds a reference to the Image so the pixels stay valid for
+        //! as long as VSG needs them (e.g. until they transfer to the GPU).
+        template<class ARRAY>
+        class ImageView : public ARRAY
+        {
+        public:
+            template<typename... Args>
+            ImageView(shared_ptr<const Image> image, Args&&... args) :
+                ARRAY(std::forward<Args>(args)...), _image(image) { }
+
+        private:
+            shared_ptr<const Image> _image;
+        };
+
+        template<typename T>
+        vsg::ref_ptr<vsg::Data> share(shared_ptr<const Image> image, VkFormat format)
+        {
+            // VSG never writes to the array, but its constructors want a non-const pointer.
+            T* data = const_cast<T*>(image->data<T>());
+
+            vsg::Data::Properties props;
+            props.format = format;
+            props.allocatorType = vsg::ALLOCATOR_TYPE_NO_DELETE; // the Image owns the memory
+
+            // For compressed formats, VSG measures the array in blocks.
+            unsigned block = image->blockSize();
+            props.blockWidth = block;
+            props.blockHeight = block;
+            props.maxNumMipmaps = image->mipmapLevels();
+            unsigned width = (image->width() + block - 1) / block;
+            unsigned height = (image->height() + block - 1) / block;
+
+            if (image->depth() == 1)
+            {
+                return vsg::ref_ptr<vsg::Data>(new ImageView<vsg::Array2D<T>>(
+                    image, width, height, data, props));
+            }
+            else
+            {
+                return vsg::ref_ptr<vsg::Data>(new ImageView<vsg::Array3D<T>>(
+                    image, width, height, image->depth(), data, props));
+            }
+        }
+
+        //! Wraps a rocky Image in a VSG Data object without copying the pixels.
+        //! Unlike moveImageToVSG, the source Image remains valid, but it must not
+        //! be modified while the returned object exists.
+        inline vsg::ref_ptr<vsg::Data> shareImageWithVSG(shared_ptr<const Image> image)
+        {
+            if (!image || !image->valid())
+                return {};
+
+            vsg::ref_ptr<vsg::Data> data;
+
+            switch (image->pixelFormat())
+            {
+            case Image::R8_UNORM:
+                data = share<unsigned char>(image, VK_FORMAT_R8_UNORM);
+                break;
+            case Image::R8G8_UNORM:
+                data = share<vsg::ubvec2>(image, VK_FORMAT_R8G8_UNORM);
+                break;
+            case Image::R8G8B8_UNORM:
+                data = share<vsg::ubvec3>(image, VK_FORMAT_R8G8B8_UNORM);
+                break;
+            case Image::R8G8B8A8_UNORM:
+                data = share<vsg::ubvec4>(image, VK_FORMAT_R8G8B8A8_UNORM);
+                break;
+            case Image::R16_UNORM:
+                data = share<unsigned short>(image, VK_FORMAT_R16_UNORM);
+                break;
+            case Image::R32_SFLOAT:
+                data = share<float>(image, VK_FORMAT_R32_SFLOAT);
+                break;
+            case Image::R64_SFLOAT:
+                data = share<double>(image, VK_FORMAT_R64_SFLOAT);
+                break;
+            case Image::BC1_RGBA_UNORM:
+                data = share<vsg::block64>(image, VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+                break;
+            case Image::BC3_UNORM:
+                data = share<vsg::block128>(image, VK_FORMAT_BC3_UNORM_BLOCK);
+                break;
+            default:
+                return {};
+            };
+
+            data->properties.origin = vsg::TOP_LEFT;
 
             return data;
         }
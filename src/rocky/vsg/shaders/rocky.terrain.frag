@@ -2,6 +2,8 @@
 #extension GL_NV_fragment_shader_barycentric : enable
 #pragma import_defines(RK_LIGHTING)
 #pragma import_defines(RK_WIREFRAME_OVERLAY)
+#pragma import_defines(RK_BINDLESS)
+#pragma import_defines(RK_NORMAL_MAPS)
 
 layout(push_constant) uniform PushConstants
 {
@@ -21,8 +23,28 @@ struct RkData {
 layout(location = 0) in RkData rk;
 
 // uniforms
+#if defined(RK_BINDLESS)
+// must match rocky::TerrainTileTable::capacity
+#define RK_TILE_TABLE_SIZE 4096
+layout(set = 0, binding = 11) uniform sampler2D color_tex[RK_TILE_TABLE_SIZE];
+layout(set = 0, binding = 12) uniform sampler2D normal_tex[RK_TILE_TABLE_SIZE];
+// texture array indices (color, normal) from the vertex shader
+layout(location = 4) flat in ivec2 rk_textures;
+#define COLOR_TEX color_tex[rk_textures.x]
+#define NORMAL_TEX normal_tex[rk_textures.y]
+#else
 layout(set = 0, binding = 11) uniform sampler2D color_tex;
 layout(set = 0, binding = 12) uniform sampler2D normal_tex;
+#define COLOR_TEX color_tex
+#define NORMAL_TEX normal_tex
+#endif
+
+#if defined(RK_NORMAL_MAPS)
+// normal map coordinates, and the tile's tangent frame in view space
+layout(location = 5) in vec2 rk_normal_uv;
+layout(location = 6) in vec3 rk_east_view;
+layout(location = 7) in vec3 rk_north_view;
+#endif
 
 #if defined(RK_LIGHTING)
 #include "rocky.lighting.frag.glsl"
@@ -33,16 +55,30 @@ layout(location = 0) out vec4 out_color;
 
 vec3 get_normal()
 {
-    // temporary! until we support normal maps
+#if defined(RK_NORMAL_MAPS)
+    // The normal map holds one tangent-space normal per elevation sample,
+    // so sample it on texel centers just like the elevation.
+    float size = float(textureSize(NORMAL_TEX, 0).x);
+    vec2 uv = rk_normal_uv * ((size - 1.0) / size) + 0.5 / size;
+    vec3 n = texture(NORMAL_TEX, uv).xyz * 2.0 - 1.0;
+
+    mat3 tangent_to_view = mat3(
+        normalize(rk_east_view),
+        normalize(rk_north_view),
+        normalize(rk.up_view));
+
+    return normalize(tangent_to_view * n);
+#else
     vec3 dx = dFdx(rk.vertex_view);
     vec3 dy = dFdy(rk.vertex_view);
     vec3 n = -normalize(cross(dx, dy));
     return n;
+#endif
 }
 
 void main()
 {
-    vec4 texel = texture(color_tex, rk.uv);
+    vec4 texel = texture(COLOR_TEX, rk.uv);
     out_color = mix(rk.color, clamp(texel, 0, 1), texel.a);
 
     if (gl_FrontFacing == false)
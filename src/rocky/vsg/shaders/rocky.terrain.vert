@@ -1,8 +1,16 @@
 #version 450
 #pragma import_defines(RK_LIGHTING)
 #pragma import_defines(RK_ATMOSPHERE)
+#pragma import_defines(RK_BINDLESS)
+#pragma import_defines(RK_NORMAL_MAPS)
 
+#if defined(RK_BINDLESS)
+// must match rocky::TerrainTileTable::capacity
+#define RK_TILE_TABLE_SIZE 4096
+layout(set = 0, binding = 10) uniform sampler2D elevation_tex[RK_TILE_TABLE_SIZE];
+#else
 layout(set = 0, binding = 10) uniform sampler2D elevation_tex;
+#endif
 
 layout(push_constant) uniform PushConstants
 {
@@ -10,6 +18,27 @@ layout(push_constant) uniform PushConstants
     mat4 modelview;
 } pc;
 
+#if defined(RK_BINDLESS)
+// see rocky::TerrainTileTable::TileData
+struct TileData
+{
+    mat4 elevation_matrix;
+    mat4 color_matrix;
+    mat4 normal_matrix;
+    mat4 model_matrix;
+    int elevation_index;
+    int color_index;
+    int normal_index;
+    int padding;
+};
+layout(set = 0, binding = 13) readonly buffer TileTable
+{
+    TileData tiles[];
+};
+// each tile's draw command passes its table slot as the first instance
+#define tile tiles[gl_InstanceIndex]
+#define ELEVATION_TEX elevation_tex[tile.elevation_index]
+#else
 // see rocky::TerrainTileDescriptors
 layout(set = 0, binding = 13) uniform TileData
 {
@@ -18,6 +47,8 @@ layout(set = 0, binding = 13) uniform TileData
     mat4 normal_matrix;
     mat4 model_matrix;
 } tile;
+#define ELEVATION_TEX elevation_tex
+#endif
 
 // input vertex attributes
 layout(location = 0) in vec3 in_vertex;
@@ -35,6 +66,18 @@ struct RkData {
 // output varyings
 layout(location = 0) out RkData rk;
 
+#if defined(RK_BINDLESS)
+// texture array indices (color, normal) for the fragment shader
+layout(location = 4) flat out ivec2 rk_textures;
+#endif
+
+#if defined(RK_NORMAL_MAPS)
+// normal map coordinates, and the tile's tangent frame in view space
+layout(location = 5) out vec2 rk_normal_uv;
+layout(location = 6) out vec3 rk_east_view;
+layout(location = 7) out vec3 rk_north_view;
+#endif
+
 #if defined(RK_ATMOSPHERE)
 #include "rocky.atmo.ground.vert.glsl"
 #endif
@@ -47,7 +90,7 @@ out gl_PerVertex {
 // sample the elevation data at a UV tile coordinate
 float terrain_get_elevation(in vec2 uv)
 {
-    float size = float(textureSize(elevation_tex, 0).x);
+    float size = float(textureSize(ELEVATION_TEX, 0).x);
     vec2 coeff = vec2((size - 1.0) / size, 0.5 / size);
 
     // Texel-level scale and bias allow us to sample the elevation texture
@@ -57,7 +100,7 @@ float terrain_get_elevation(in vec2 uv)
         + coeff.x * tile.elevation_matrix[3].st // bias
         + coeff.y;
 
-    return texture(elevation_tex, elevc).r;
+    return texture(ELEVATION_TEX, elevc).r;
 }
 
 void main()
@@ -76,6 +119,20 @@ void main()
     rk.color = vec4(1); // placeholder
     rk.uv = (tile.color_matrix * vec4(in_uvw.st, 0, 1)).st;
     rk.vertex_view = position_view.xyz / position_view.w;
+
+#if defined(RK_NORMAL_MAPS)
+    rk_normal_uv = (tile.normal_matrix * vec4(in_uvw.st, 0, 1)).st;
+
+    // the tile's local frame is east-north-up, so +Y points north
+    vec3 east = normalize(cross(vec3(0, 1, 0), in_normal));
+    vec3 north = cross(in_normal, east);
+    rk_east_view = normal_matrix * east;
+    rk_north_view = normal_matrix * north;
+#endif
+
+#if defined(RK_BINDLESS)
+    rk_textures = ivec2(tile.color_index, tile.normal_index);
+#endif
     
     gl_Position = pc.projection * position_view;
 }
@@ -9,9 +9,11 @@
 #include <cfloat>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <type_traits>
@@ -31,8 +33,8 @@
 
 // Version
 #define WEEJOBS_VERSION_MAJOR 1
-#define WEEJOBS_VERSION_MINOR 0
-#define WEEJOBS_VERSION_REV   1
+#define WEEJOBS_VERSION_MINOR 1
+#define WEEJOBS_VERSION_REV   0
 #define WEEJOBS_STR_NX(s) #s
 #define WEEJOBS_STR(s) WEEJOBS_STR_NX(s)
 #define WEEJOBS_COMPUTE_VERSION(major, minor, patch) ((major) * 10000 + (minor) * 100 + (patch))
@@ -468,21 +470,166 @@ namespace WEEJOBS_NAMESPACE
         {
             context ctx;
             std::function<bool()> _delegate;
+            float _priority = 0.0f; // cached result of ctx.priority()
+            std::uint64_t _sequence = 0u; // dispatch order
 
+            //! Calls the user's priority function
+            float evaluate_priority() const
+            {
+                return ctx.priority ? ctx.priority() : 0.0f;
+            }
+
+            //! Heap ordering: higher cached priority first, then
+            //! first-in-first-out amongst equal priorities
             bool operator < (const job& rhs) const
             {
-                float lp = ctx.priority ? ctx.priority() : -FLT_MAX;
-                float rp = rhs.ctx.priority ? rhs.ctx.priority() : -FLT_MAX;
-                return lp < rp;
+                if (_priority != rhs._priority)
+                    return _priority < rhs._priority;
+                return _sequence > rhs._sequence;
             }
         };
 
+        /**
+         * Chase-Lev work-stealing deque of jobs. The owning thread pushes and
+         * pops at the bottom without locking; any other thread may steal from
+         * the top. Based on Le, Pop, Cohen & Zappa Nardelli, "Correct and
+         * Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+         */
+        class job_deque
+        {
+        public:
+            job_deque()
+            {
+                _buffer.store(new buffer(64), std::memory_order_relaxed);
+            }
+
+            ~job_deque()
+            {
+                while (job* j = pop())
+                    delete j;
+                delete _buffer.load(std::memory_order_relaxed);
+            }
+
+            //! Push a job onto the bottom (owner thread only)
+            void push(job* j)
+            {
+                std::int64_t b = _bottom.load(std::memory_order_relaxed);
+                std::int64_t t = _top.load(std::memory_order_acquire);
+                buffer* buf = _buffer.load(std::memory_order_relaxed);
+
+                if (b - t > buf->capacity - 1)
+                {
+                    // full; grow it. Thieves may still be reading the old buffer,
+                    // so retire it instead of deleting it.
+                    auto bigger = new buffer(buf->capacity * 2);
+                    for (std::int64_t i = t; i < b; ++i)
+                        bigger->put(i, buf->get(i));
+                    _retired.emplace_back(buf);
+                    _buffer.store(bigger, std::memory_order_release);
+                    buf = bigger;
+                }
+
+                buf->put(b, j);
+                std::atomic_thread_fence(std::memory_order_release);
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            //! Pop a job from the bottom (owner thread only), or nullptr if empty
+            job* pop()
+            {
+                std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+                buffer* buf = _buffer.load(std::memory_order_relaxed);
+                _bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                std::int64_t t = _top.load(std::memory_order_relaxed);
+
+                job* result = nullptr;
+                if (t <= b)
+                {
+                    result = buf->get(b);
+                    if (t == b)
+                    {
+                        // last one; race against thieves for it.
+                        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                            result = nullptr;
+                        _bottom.store(b + 1, std::memory_order_relaxed);
+                    }
+                }
+                else
+                {
+                    _bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                return result;
+            }
+
+            //! Steal a job from the top (any thread). Returns nullptr if
+            //! the deque is empty or another thread won the race.
+            job* steal()
+            {
+                std::int64_t t = _top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                std::int64_t b = _bottom.load(std::memory_order_acquire);
+
+                if (t < b)
+                {
+                    buffer* buf = _buffer.load(std::memory_order_acquire);
+                    job* result = buf->get(t);
+                    if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                        return result;
+                }
+                return nullptr;
+            }
+
+            //! Whether the deque appears to be empty (approximate)
+            bool empty() const
+            {
+                return _bottom.load(std::memory_order_acquire) <= _top.load(std::memory_order_acquire);
+            }
+
+            //! next deque in the owning pool's list
+            job_deque* _next = nullptr;
+
+        private:
+            struct buffer
+            {
+                buffer(std::int64_t c) : capacity(c), slots(new std::atomic<job*>[c]) { }
+                job* get(std::int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+                void put(std::int64_t i, job* j) { slots[i & (capacity - 1)].store(j, std::memory_order_relaxed); }
+                const std::int64_t capacity; // always a power of two
+                std::unique_ptr<std::atomic<job*>[]> slots;
+            };
+
+            std::atomic<std::int64_t> _top = { 0 };
+            std::atomic<std::int64_t> _bottom = { 0 };
+            std::atomic<buffer*> _buffer;
+            std::vector<std::unique_ptr<buffer>> _retired;
+        };
+
+        //! Identifies the job pool (and local deque) of the calling thread,
+        //! if the calling thread is a job pool worker.
+        struct worker_t
+        {
+            class jobpool* pool = nullptr;
+            job_deque* deque = nullptr;
+        };
+
+        inline worker_t& this_worker()
+        {
+            static thread_local worker_t worker;
+            return worker;
+        }
+
         inline bool steal_job(class jobpool* thief, detail::job& stolen);
     }
 
     /**
     * A priority-sorted collection of jobs that are running or waiting
     * to run in a thread pool.
+    *
+    * Jobs with a priority function go into a shared priority queue.
+    * Jobs without one that are dispatched from one of the pool's own threads
+    * (e.g. continuations) go into that thread's local deque instead; the
+    * thread runs them next, without locking, and idle threads steal them.
     */
     class jobpool
     {
@@ -506,6 +653,14 @@ namespace WEEJOBS_NAMESPACE
         ~jobpool()
         {
             stop_threads();
+            join_threads();
+
+            for (auto d = _deques.load(); d != nullptr; )
+            {
+                auto next = d->_next;
+                delete d;
+                d = next;
+            }
         }
 
         //! Name of this job pool
@@ -543,14 +698,36 @@ namespace WEEJOBS_NAMESPACE
             _can_steal_work = value;
         }
 
+        //! How often to re-evaluate the priority of every queued job.
+        //! Between refreshes, only the job at the top of the queue is
+        //! re-evaluated when it's taken. Default = 16ms.
+        void set_priority_refresh_interval(std::chrono::steady_clock::duration value)
+        {
+            std::lock_guard<std::mutex> lock(_queue_mutex);
+            _priority_refresh_interval = value;
+        }
+
         //! Discard all queued jobs
         void cancel_all()
         {
             std::lock_guard<std::mutex> lock(_queue_mutex);
+
+            // Account for each job we discard. Don't just zero the counts:
+            // our threads may be pushing more jobs to their deques right now.
+            unsigned count = (unsigned)_queue.size();
+            for (auto& queuedjob : _queue)
+            {
+                if (queuedjob.ctx.group != nullptr)
+                {
+                    queuedjob.ctx.group->release();
+                }
+            }
             _queue.clear();
-            _queue_size = 0;
-            _metrics.canceled += _metrics.pending;
-            _metrics.pending = 0;
+            _queue_size -= (int)count;
+            _metrics.pending -= count;
+
+            count += _drain_local_jobs();
+            _metrics.canceled += count;
         }
 
         //! Schedule an asynchronous task on this scheduler
@@ -567,11 +744,36 @@ namespace WEEJOBS_NAMESPACE
                     context.group->acquire();
                 }
 
-                if (_target_concurrency > 0)
+                auto& worker = detail::this_worker();
+
+                if (worker.pool == this && !context.priority)
                 {
+                    // unprioritized job dispatched from one of our own threads:
+                    // push it onto that thread's local deque. No lock required.
+                    _queue_size++;
+                    _metrics.pending++;
+                    _metrics.total++;
+
+                    worker.deque->push(new detail::job{ context, delegate });
+
+                    // only touch the mutex if someone might be asleep.
+                    if (_sleepers > 0)
+                    {
+                        std::lock_guard<std::mutex> lock(_queue_mutex);
+                        _block.notify_one();
+                    }
+                }
+                else if (_target_concurrency > 0)
+                {
+                    // evaluate the priority before taking the lock
+                    detail::job new_job{ context, delegate };
+                    new_job._priority = new_job.evaluate_priority();
+
                     std::lock_guard<std::mutex> lock(_queue_mutex);
 
-                    _queue.emplace_back(detail::job{ context, delegate });
+                    new_job._sequence = _sequence++;
+                    _queue.emplace_back(std::move(new_job));
+                    std::push_heap(_queue.begin(), _queue.end());
                     _queue_size++;
 
                     _metrics.pending++;
@@ -601,28 +803,65 @@ namespace WEEJOBS_NAMESPACE
                 std::lock_guard<std::mutex> lock(_queue_mutex);
                 return _take_job(output, false);
             }
-            else if (!_done && _queue_size > 0)
+            else if (!_done && !_queue.empty())
             {
-                auto ptr = _queue.end();
-                float highest_priority = -FLT_MAX;
-                for (auto iter = _queue.begin(); iter != _queue.end(); ++iter)
+                auto now = std::chrono::steady_clock::now();
+                if (now - _last_priority_refresh >= _priority_refresh_interval)
                 {
-                    float priority = iter->ctx.priority != nullptr ?
-                        iter->ctx.priority() :
-                        0.0f;
+                    // periodically re-evaluate everything and rebuild the heap
+                    for (auto& job : _queue)
+                        job._priority = job.evaluate_priority();
 
-                    if (ptr == _queue.end() || priority > highest_priority)
+                    std::make_heap(_queue.begin(), _queue.end());
+                    _last_priority_refresh = now;
+                }
+                else
+                {
+                    // between refreshes, make sure the top job's priority hasn't
+                    // dropped since it was last evaluated; if it has, sink it and
+                    // check the new top (a few times at most).
+                    for (int i = 0; i < 4 && _queue.size() > 1; ++i)
                     {
-                        ptr = iter;
-                        highest_priority = priority;
+                        float priority = _queue.front().evaluate_priority();
+                        if (priority >= _queue.front()._priority)
+                        {
+                            _queue.front()._priority = priority;
+                            break;
+                        }
+
+                        std::pop_heap(_queue.begin(), _queue.end());
+                        _queue.back()._priority = priority;
+                        std::push_heap(_queue.begin(), _queue.end());
                     }
                 }
 
-                if (ptr == _queue.end())
-                    ptr = _queue.begin();
+                std::pop_heap(_queue.begin(), _queue.end());
+                output = std::move(_queue.back());
+                _queue.pop_back();
+                _queue_size--;
+                _metrics.pending--;
+                return true;
+            }
+            return false;
+        }
+
+        //! Takes a job from a thread-local deque: first from "local" (the
+        //! calling thread's own deque, if any), then by stealing from the
+        //! other threads' deques. Returns true if a job was taken.
+        inline bool _take_local_job(detail::job& output, detail::job_deque* local)
+        {
+            detail::job* j = local ? local->pop() : nullptr;
+
+            for (auto d = _deques.load(); j == nullptr && d != nullptr; d = d->_next)
+            {
+                if (d != local && !d->empty())
+                    j = d->steal();
+            }
 
-                output = std::move(*ptr);
-                _queue.erase(ptr);
+            if (j)
+            {
+                output = std::move(*j);
+                delete j;
                 _queue_size--;
                 _metrics.pending--;
                 return true;
@@ -630,6 +869,29 @@ namespace WEEJOBS_NAMESPACE
             return false;
         }
 
+        //! Discards all jobs in the thread-local deques, releasing their
+        //! group semaphores. Returns the number of jobs discarded.
+        inline unsigned _drain_local_jobs()
+        {
+            unsigned count = 0u;
+            for (auto d = _deques.load(); d != nullptr; d = d->_next)
+            {
+                while (!d->empty())
+                {
+                    if (auto j = d->steal())
+                    {
+                        if (j->ctx.group)
+                            j->ctx.group->release();
+                        delete j;
+                        _queue_size--;
+                        _metrics.pending--;
+                        ++count;
+                    }
+                }
+            }
+            return count;
+        }
+
         //! Construct a new job pool.
         //! Do not call this directly - call getPool(name) instead.
         jobpool(const std::string& name, unsigned concurrency) :
@@ -641,7 +903,8 @@ namespace WEEJOBS_NAMESPACE
 
         //! Pulls queued jobs and runs them in whatever thread run() is called from.
         //! Runs in a loop until _done is set.
-        inline void run();
+        //! @param local Deque owned by the calling thread
+        inline void run(detail::job_deque* local);
 
         //! Spawn all threads in this scheduler
         inline void start_threads();
@@ -653,8 +916,14 @@ namespace WEEJOBS_NAMESPACE
         inline void join_threads();
 
         bool _can_steal_work = true;
-        std::list<detail::job> _queue;
-        std::atomic_int _queue_size = { 0 }; // don't use list::size(), it's slow and not atomic
+        std::vector<detail::job> _queue; // binary max-heap ordered by cached priority
+        std::uint64_t _sequence = 0u; // next job sequence number
+        std::chrono::steady_clock::duration _priority_refresh_interval = std::chrono::milliseconds(16);
+        std::chrono::steady_clock::time_point _last_priority_refresh;
+        std::atomic_int _queue_size = { 0 }; // total pending jobs, shared queue + local deques
+        std::atomic<detail::job_deque*> _deques = { nullptr }; // one per thread (linked list)
+        std::vector<detail::job_deque*> _idle_deques; // deques whose threads have exited; protected by _quit_mutex
+        std::atomic_int _sleepers = { 0 }; // number of threads waiting on _block
         mutable std::mutex _queue_mutex; // protect access to the queue
         mutable std::mutex _quit_mutex; // protects access to _done
         std::atomic<unsigned> _target_concurrency; // target number of concurrent threads in the pool
@@ -879,12 +1148,20 @@ namespace WEEJOBS_NAMESPACE
                 pool->join_threads();
     }
 
-    inline void jobpool::run()
+    inline void jobpool::run(detail::job_deque* local)
     {
+        detail::this_worker() = { this, local };
+
+        bool retired = false;
+
         while (!_done)
         {
             detail::job next;
-            bool have_next = false;
+
+            // our own deque (and our siblings') first; no locking required.
+            bool have_next = _take_local_job(next, local);
+
+            if (!have_next)
             {
                 if (_can_steal_work && instance()._stealing_allowed)
                 {
@@ -892,9 +1169,11 @@ namespace WEEJOBS_NAMESPACE
                         std::unique_lock<std::mutex> lock(_queue_mutex);
 
                         // work-stealing enabled: wait until any queue is non-empty
+                        _sleepers++;
                         _block.wait(lock, [this]() { return get_metrics()->total_pending() > 0 || _done; });
+                        _sleepers--;
 
-                        if (!_done && _queue_size > 0)
+                        if (!_done)
                         {
                             have_next = _take_job(next, false);
                         }
@@ -910,9 +1189,11 @@ namespace WEEJOBS_NAMESPACE
                     std::unique_lock<std::mutex> lock(_queue_mutex);
 
                     // wait until just our local queue is non-empty
+                    _sleepers++;
                     _block.wait(lock, [this] { return (_queue_size > 0) || _done; });
+                    _sleepers--;
 
-                    if (!_done && _queue_size > 0)
+                    if (!_done)
                     {
                         have_next = _take_job(next, false);
                     }
@@ -950,9 +1231,19 @@ namespace WEEJOBS_NAMESPACE
             if (_target_concurrency < _metrics.concurrency)
             {
                 _metrics.concurrency--;
+                retired = true;
                 break;
             }
         }
+
+        detail::this_worker() = { };
+
+        // Hand our deque to the next thread we start. Anything left in it
+        // is still visible to the other threads, who will steal it.
+        std::lock_guard<std::mutex> lock(_quit_mutex);
+        if (!retired)
+            _metrics.concurrency--;
+        _idle_deques.push_back(local);
     }
 
     inline void jobpool::start_threads()
@@ -964,13 +1255,33 @@ namespace WEEJOBS_NAMESPACE
         {
             _metrics.concurrency++;
 
-            _threads.push_back(std::thread([this]
+            // each thread gets its own deque, re-using one that an exited
+            // thread left behind if possible. Deques are never removed,
+            // so other threads can traverse the list without locking.
+            detail::job_deque* deque = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(_quit_mutex);
+                if (!_idle_deques.empty())
+                {
+                    deque = _idle_deques.back();
+                    _idle_deques.pop_back();
+                }
+            }
+
+            if (!deque)
+            {
+                deque = new detail::job_deque();
+                deque->_next = _deques.load();
+                _deques.store(deque);
+            }
+
+            _threads.push_back(std::thread([this, deque]
                 {
                     if (instance()._set_thread_name)
                     {
                         instance()._set_thread_name(_metrics.name.c_str());
                     }
-                    run();
+                    run(deque);
                 }
             ));
         }
@@ -992,8 +1303,10 @@ namespace WEEJOBS_NAMESPACE
                 queuedjob.ctx.group->release();
             }
         }
+        _queue_size -= (int)_queue.size();
+        _metrics.pending -= (unsigned)_queue.size();
         _queue.clear();
-        _queue_size = 0;
+        _drain_local_jobs();
 
         // wake up all threads so they can exit
         _block.notify_all();
@@ -1037,7 +1350,9 @@ namespace WEEJOBS_NAMESPACE
 
         if (pool_with_most_jobs)
         {
-            return pool_with_most_jobs->_take_job(stolen, true);
+            return
+                pool_with_most_jobs->_take_local_job(stolen, nullptr) ||
+                pool_with_most_jobs->_take_job(stolen, true);
         }
 
         return false;
@@ -3,22 +3,32 @@
 
 #include <rocky/Instance.h>
 #include <rocky/Color.h>
+#include <rocky/DiskCache.h>
+#include <rocky/ElevationLayer.h>
+#include <rocky/ElevationPool.h>
+#include <rocky/Feature.h>
 #include <rocky/Log.h>
 #include <rocky/Map.h>
 #include <rocky/Math.h>
 #include <rocky/Image.h>
 #include <rocky/Heightfield.h>
 #include <rocky/TileKey.h>
+#include <rocky/TileSeeder.h>
 #include <rocky/URI.h>
 #include <rocky/Utils.h>
 #include <rocky/contrib/EarthFileImporter.h>
 
+#include <filesystem>
 #include <random>
 
 #ifdef ROCKY_HAS_GDAL
 #include <rocky/GDALImageLayer.h>
 #endif
 
+#ifdef ROCKY_HAS_MBTILES
+#include <rocky/MBTiles.h>
+#endif
+
 #ifdef ROCKY_HAS_TMS
 #include <rocky/TMSImageLayer.h>
 #endif
@@ -37,6 +47,25 @@ namespace
             return StatusOK;
         }
     };
+
+    // Elevation equal to the longitude, everywhere
+    class TestElevationLayer : public Inherit<ElevationLayer, TestElevationLayer>
+    {
+    public:
+        TestElevationLayer() {
+            setProfile(Profile::GLOBAL_GEODETIC);
+        }
+
+    protected:
+        Result<GeoHeightfield> createHeightfieldImplementation(const TileKey& key, const IOOptions& io) const override {
+            auto& ex = key.extent();
+            auto hf = Heightfield::create(257, 257);
+            for (unsigned r = 0; r < hf->height(); ++r)
+                for (unsigned c = 0; c < hf->width(); ++c)
+                    hf->heightAt(c, r) = (float)(ex.xmin() + ex.width() * (double)c / 256.0);
+            return GeoHeightfield(hf, ex);
+        }
+    };
 }
 
 TEST_CASE("json")
@@ -130,6 +159,163 @@ TEST_CASE("Threading")
     CHECK(f2.value() == 123);
 }
 
+TEST_CASE("Job priority")
+{
+    // queue up jobs before starting the pool's thread so they
+    // have to come out in priority order.
+    std::vector<int> order;
+    jobs::jobpool pool("test", 1);
+    auto group = jobs::jobgroup::create();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        jobs::context context;
+        context.pool = &pool;
+        context.group = group;
+        context.priority = [i]() { return (float)(i % 10); };
+        jobs::dispatch([&order, i]() { order.push_back(i); }, context);
+    }
+
+    pool.start_threads();
+    group->join();
+    pool.stop_threads();
+    pool.join_threads();
+
+    REQUIRE(order.size() == 100);
+    bool sorted = true;
+    for (unsigned i = 1; i < order.size(); ++i)
+    {
+        int a = order[i - 1] % 10, b = order[i] % 10;
+        if (a < b || (a == b && order[i - 1] > order[i]))
+            sorted = false;
+    }
+    CHECK(sorted);
+}
+
+TEST_CASE("Work-stealing deque")
+{
+    // The owner pushes and pops while several thieves steal. Every job
+    // must come out exactly once. There are enough jobs to grow the buffer.
+    const int count = 100000;
+    std::vector<std::atomic_int> taken(count);
+    jobs::detail::job_deque deque;
+    std::atomic_bool done = { false };
+
+    auto run = [](jobs::detail::job* j)
+        {
+            if (j)
+            {
+                j->_delegate();
+                delete j;
+            }
+            return j != nullptr;
+        };
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 4; ++t)
+    {
+        thieves.emplace_back([&]()
+            {
+                while (!done)
+                    run(deque.steal());
+            });
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        deque.push(new jobs::detail::job{ {}, [&taken, i]() { ++taken[i]; return true; } });
+        if (i % 3 == 0)
+            run(deque.pop());
+    }
+
+    // pop fails only once the deque is empty:
+    while (run(deque.pop()));
+
+    done = true;
+    for (auto& thief : thieves)
+        thief.join();
+
+    int wrong = 0;
+    for (auto& n : taken)
+        if (n != 1)
+            ++wrong;
+    CHECK(wrong == 0);
+}
+
+TEST_CASE("Job pool restart")
+{
+    jobs::jobpool pool("test", 2);
+    pool.start_threads();
+
+    // keep the threads' deques busy, then stop and restart a few times:
+    for (int i = 0; i < 5; ++i)
+    {
+        auto group = jobs::jobgroup::create();
+        jobs::context context;
+        context.pool = &pool;
+        context.group = group;
+
+        for (int j = 0; j < 50; ++j)
+        {
+            jobs::dispatch([&pool, group]()
+                {
+                    // runs in a pool thread, so this goes into its deque:
+                    jobs::context local;
+                    local.pool = &pool;
+                    local.group = group;
+                    jobs::dispatch([]() { }, local);
+                }, context);
+        }
+
+        group->join();
+        pool.stop_threads();
+        pool.join_threads();
+        CHECK(pool._queue_size == 0);
+        pool.start_threads();
+    }
+
+    // restarted threads re-use the deques:
+    unsigned deques = 0;
+    for (auto d = pool._deques.load(); d != nullptr; d = d->_next)
+        ++deques;
+    CHECK(deques == 2);
+
+    pool.cancel_all();
+    CHECK(pool._queue_size == 0);
+
+    pool.stop_threads();
+    pool.join_threads();
+}
+
+TEST_CASE("LRUCache")
+{
+    // entry-count capacity
+    util::LRUCache<int, int> cache(2);
+    cache.put(1, 1);
+    cache.put(2, 2);
+    CHECK(cache.get(1) == 1); // 1 is now most recent
+    cache.put(3, 3); // evicts 2
+    CHECK(cache.get(2) == 0);
+    CHECK(cache.get(3) == 3);
+    CHECK(cache.metrics().evictions == 1);
+    CHECK(cache.metrics().hits == 2);
+
+    // size-based capacity across shards
+    util::LRUCache<int, std::string> sized(1000, 4,
+        [](const std::string& s) { return s.size(); });
+    for (int i = 0; i < 100; ++i)
+        sized.put(i, std::string(50, 'x'));
+    auto m = sized.metrics();
+    CHECK(m.size <= 1000);
+    CHECK(m.entries == m.size / 50);
+    CHECK(sized.get(99).size() == 50);
+
+    // values too big for a shard are not cached
+    sized.put(1000, std::string(2000, 'x'));
+    CHECK(sized.get(1000).empty());
+    CHECK(sized.metrics().rejections == 1);
+}
+
 TEST_CASE("Math")
 {
     CHECK(is_identity(glm::fmat4(1)));
@@ -218,6 +404,57 @@ TEST_CASE("Image")
     CHECK(equiv(value.g, 0.5f, 0.01f));
     CHECK(equiv(value.b, 0.0f, 0.01f));
     CHECK(equiv(value.a, 1.0f, 0.01f));
+
+    // non-square images must round-trip writes and reads
+    image = Image::create(Image::R8G8B8A8_UNORM, 64, 16);
+    image->fill(Color(0, 0, 0, 1));
+    image->write(Color(1, 1, 1, 1), 40, 10);
+    image->read(value, 40, 10);
+    CHECK(equiv(value.r, 1.0f, 0.01f));
+    image->read(value, 8, 3);
+    CHECK(equiv(value.r, 0.0f, 0.01f));
+
+    // block compression
+    image = Image::create(Image::R8G8B8A8_UNORM, 30, 30);
+    image->fill(Color(1, 0.5, 0.0, 1));
+    auto bc1 = image->compress(Image::BC1_RGBA_UNORM);
+    REQUIRE(bc1);
+    if (bc1) {
+        CHECK(bc1->compressed());
+        CHECK(bc1->sizeInBytes() == 8 * 8 * 8);
+        bc1->read(value, 29, 29);
+        CHECK(equiv(value.r, 1.0f, 0.02f));
+        CHECK(equiv(value.g, 0.5f, 0.02f));
+        CHECK(equiv(value.b, 0.0f, 0.02f));
+        CHECK(equiv(value.a, 1.0f, 0.02f));
+    }
+    auto bc3 = image->compress(Image::BC3_UNORM);
+    REQUIRE(bc3);
+    if (bc3) {
+        CHECK(bc3->sizeInBytes() == 8 * 8 * 16);
+    }
+
+    // mipmaps
+    image = Image::create(Image::R8G8B8A8_UNORM, 256, 128);
+    image->fill(Color(1, 0.5, 0.0, 1));
+    auto mipmapped = image->generateMipmaps();
+    REQUIRE(mipmapped);
+    CHECK(image->mipmapLevels() == 1); // original untouched
+    image = mipmapped;
+    CHECK(image->mipmapLevels() == 9);
+    CHECK(image->sizeInBytes() == 131072);
+    CHECK(image->sizeInBytesWithMipmaps() == 174764);
+    CHECK(image->clone()->mipmapLevels() == 9);
+    bc1 = image->compress(Image::BC1_RGBA_UNORM);
+    REQUIRE(bc1);
+    CHECK(bc1->mipmapLevels() == 9);
+    CHECK(bc1->sizeInBytesWithMipmaps() == 2733 * 8);
+
+    // mipmapped images that aren't powers of two are left uncompressed,
+    // since the GPU upload would misplace their levels:
+    image = Image::create(Image::R8G8B8A8_UNORM, 100, 100)->generateMipmaps();
+    REQUIRE(image);
+    CHECK(image->compress(Image::BC1_RGBA_UNORM) == nullptr);
 }
 
 TEST_CASE("Heightfield")
@@ -298,6 +535,139 @@ TEST_CASE("Map")
     }
 }
 
+TEST_CASE("ElevationPool")
+{
+    Instance instance;
+
+    auto map = Map::create(instance);
+    auto layer = TestElevationLayer::create();
+    REQUIRE(layer->open().ok());
+    map->layers().add(layer);
+
+    auto pool = map->elevationPool();
+    REQUIRE(pool);
+    pool->setLevelOfDetail(4);
+
+    std::vector<glm::dvec3> points = {
+        { 10.3, 20.0, 0.0 },
+        { -45.25, -30.0, 0.0 },
+        { 10.4, 20.1, 0.0 } // same tile as the first one
+    };
+
+    CHECK(pool->sample(points, SRS::WGS84, IOOptions()) == 3);
+    CHECK(std::abs(points[0].z - 10.3) < 0.01);
+    CHECK(std::abs(points[1].z - -45.25) < 0.01);
+    CHECK(std::abs(points[2].z - 10.4) < 0.01);
+    CHECK(pool->metrics().entries == 2);
+
+    CHECK(std::abs(pool->sample(GeoPoint(SRS::WGS84, 100.5, 0.0), IOOptions()) - 100.5) < 0.01);
+}
+
+TEST_CASE("TileSeeder")
+{
+    Instance instance;
+    auto map = Map::create(instance);
+
+    // a triangle that touches 3 of the 4 level-2 tiles under its bounding box:
+    auto area = std::make_shared<Feature>();
+    area->geometry = Geometry(Geometry::Type::Polygon, std::vector<glm::dvec3>{
+        { 1.0, 1.0, 0.0 }, { 80.0, 1.0, 0.0 }, { 1.0, 80.0, 0.0 } });
+    area->dirtyExtent();
+
+    TileSeeder seeder;
+    seeder.minLevel = 2;
+    seeder.maxLevel = 2;
+
+    seeder.extent = area->extent;
+    CHECK(seeder.count(map.get()) == 4);
+
+    seeder.extent = {};
+    seeder.area = area;
+    CHECK(seeder.count(map.get()) == 3);
+}
+
+#if defined(ROCKY_HAS_MBTILES) && defined(ROCKY_HAS_GDAL)
+TEST_CASE("MBTiles")
+{
+    Instance instance;
+    auto& io = instance.ioOptions();
+
+    auto map = Map::create(instance);
+    auto layer = TestElevationLayer::create();
+    REQUIRE(layer->open().ok());
+    map->layers().add(layer);
+
+    auto file = (std::filesystem::temp_directory_path() / "rocky_test.mbtiles").string();
+    std::filesystem::remove(file);
+
+    MBTiles::Options options;
+    options.uri = URI(file);
+    options.format = std::string("image/tif");
+
+    Profile profile = map->profile();
+    DataExtentList dataExtents;
+    MBTiles::Driver mbtiles;
+    REQUIRE(mbtiles.open("test", options, true, profile, dataExtents, io).ok());
+
+    // seed level 1 into the database:
+    std::atomic<unsigned> failures = { 0 };
+    TileSeeder seeder;
+    seeder.minLevel = 1;
+    seeder.maxLevel = 1;
+    seeder.onTile = [&](const TileLayer*, const TileKey& key, shared_ptr<Image> image)
+        {
+            if (mbtiles.write(key, image, io).failed())
+                ++failures;
+        };
+    REQUIRE(seeder.run(map.get(), io).ok());
+    CHECK(failures == 0);
+    mbtiles.flush();
+
+    // and read one back:
+    TileKey key(1, 3, 0, profile);
+    auto r = mbtiles.read(key, io);
+    CHECKED_IF(r.status.ok())
+    {
+        CHECK(r.value->width() == 257);
+        CHECK(r.value->height() == 257);
+        glm::fvec4 pixel;
+        r.value->read(pixel, 0, 0);
+        CHECK(std::abs(pixel.r - key.extent().xmin()) < 0.01);
+    }
+
+    mbtiles.close();
+    std::filesystem::remove(file);
+}
+#endif // ROCKY_HAS_MBTILES && ROCKY_HAS_GDAL
+
+TEST_CASE("Cache")
+{
+    auto root = std::filesystem::temp_directory_path() / "rocky_test_cache";
+    std::filesystem::remove_all(root);
+
+    auto cache = DiskCache::create(root.string());
+    REQUIRE(cache);
+
+    CHECK(cache->read("bin", "1/2/3").status.failed());
+
+    CHECK(cache->write("bin", "1/2/3", "Hello, world").ok());
+    auto r = cache->read("bin", "1/2/3");
+    CHECK(r.status.ok());
+    CHECK(r.value.data == "Hello, world");
+    CHECK(r.value.lastModified > 0);
+
+    CachePolicy policy;
+    policy.maxAge = Duration(1.0, Units::HOURS);
+    CHECK(policy.isExpired(r.value.lastModified) == false);
+    CHECK(policy.isExpired(r.value.lastModified - 7200) == true);
+
+    CHECK(cache->remove("bin", "1/2/3").ok());
+    CHECK(cache->read("bin", "1/2/3").status.failed());
+
+    CHECK(cache->clear("bin").ok());
+    std::filesystem::remove_all(root);
+}
+
 #ifdef ROCKY_HAS_GDAL
 TEST_CASE("GDAL")
 {